@@ -0,0 +1,63 @@
+#include "index.hpp"
+#include "bench/corpus_generator.hpp"
+#include "util/alloc_profiling.hpp"
+using std::cout;
+
+// Allocation benchmark for the indexer: counts calls to operator new while ingesting pages and
+// while calculating page ranks. Two corpora share the same pages and distinct words, but the second
+// repeats every page's words 10 times, so the difference between them is the cost of more tokens.
+//
+// usage: bench/alloc_bench [pages] [directory for the generated corpora]
+
+// allocations made while indexing one corpus
+struct AllocationCounts {
+    long tokens = 0; // words in the corpus
+    long pages = 0; // allocations made by ingest_pages
+    long page_ranks = 0; // allocations made by calculate_page_ranks
+    int iterations = 0; // iterations of calculate_page_ranks
+};
+
+/**
+ * Counts the allocations of indexing a corpus
+ * @param options: shape of the corpus
+ * @param path: where to write the corpus
+ * @return allocation counts
+*/
+AllocationCounts count_allocations(const CorpusOptions& options, const string& path) {
+    AllocationCounts counts;
+    counts.tokens = generate_corpus(options, path).words;
+    Index index(path);
+    long before = allocation_count();
+
+    if (index.ingest_pages() != 0) {
+        cout << "could not load " << path << '\n';
+        exit(1);
+    }
+
+    counts.pages = allocation_count() - before;
+
+    index.batch_links();
+    index.batch_relevance();
+    index.batch_weights();
+    before = allocation_count();
+    counts.iterations = index.calculate_page_ranks();
+    counts.page_ranks = allocation_count() - before;
+
+    return counts;
+}
+
+int main(int argc, char** argv) {
+    CorpusOptions options;
+    options.pages = argc > 1 ? atoi(argv[1]) : 2000;
+    string dir = argc > 2 ? argv[2] : "/tmp";
+
+    AllocationCounts x1 = count_allocations(options, dir + "/alloc_bench_short.xml");
+    options.repeat = 10;
+    AllocationCounts x10 = count_allocations(options, dir + "/alloc_bench_long.xml");
+
+    cout << "pages: " << options.pages << '\n';
+    cout << "x1 words:  " << x1.tokens << " tokens, " << x1.pages << " allocations (" << (double) x1.pages / options.pages << " per page)\n";
+    cout << "x10 words: " << x10.tokens << " tokens, " << x10.pages << " allocations (" << (double) x10.pages / options.pages << " per page)\n";
+    cout << "allocations per extra token: " << (double) (x10.pages - x1.pages) / (x10.tokens - x1.tokens) << '\n';
+    cout << "page ranks: " << x1.page_ranks << " allocations over " << x1.iterations << " iterations\n";
+}
@@ -0,0 +1,235 @@
+#include "query.hpp"
+#include "bench/corpus_generator.hpp"
+#include <fstream>
+#include <random>
+#include <chrono>
+#include <iomanip>
+#include <set>
+using std::ifstream;
+using std::mt19937;
+using std::uniform_int_distribution;
+using std::set;
+using std::setw;
+using std::fixed;
+using std::setprecision;
+
+// Score-at-a-time benchmark: indexes a corpus with impact ordered postings, then replays a query log
+// and queries made of the most common words (the pathological ones, whose postings are the longest)
+// term-at-a-time over every posting, score-at-a-time until the top 10 is settled, and score-at-a-time
+// within a postings budget. Reports latency percentiles, the share of the query's postings processed,
+// how often the top 10 was proven settled early, and how far the top 10 agrees with term-at-a-time.
+//
+// usage: bench/anytime_bench [--corpus PATH | --pages N] [--queries PATH | --num-queries N] [--budget N]
+//                            [--impact-bits 8|16] [--pagerank on|off] [--threads N]
+
+// how a query is run
+enum Mode {
+    TAAT, // every posting, term by term, then the top 10 of every document
+    SAAT, // by descending impact, until the top 10 can't change
+    SAAT_BUDGET // by descending impact, at most the budget
+};
+
+// outcome of one replayed query
+struct Sample {
+    double micros; // latency in microseconds
+    double processed; // share of the query's postings processed
+    bool stable; // stopped early with a settled top 10
+    vector<int> docs; // top 10, best first
+};
+
+/**
+ * Finds a percentile of sorted latencies
+ * @param sorted: latencies, sorted ascending
+ * @param p: percentile, in [0, 100]
+ * @return latency at that percentile
+*/
+double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    size_t i = (size_t) (p / 100 * (sorted.size() - 1) + 0.5);
+
+    return sorted[min(i, sorted.size() - 1)];
+}
+
+/**
+ * Makes queries of 2 or 3 of the most common words of the synthetic corpus
+ * @param count: number of queries
+ * @param common: how many of the most common words to pick from
+ * @return the queries
+*/
+vector<string> common_word_queries(int count, int common) {
+    vector<string> queries;
+    mt19937 rng(11);
+    uniform_int_distribution<int> ranks(0, common - 1);
+
+    for (int i = 0; i < count; i++) {
+        string query = make_word(ranks(rng));
+
+        for (int j = 1; j < 2 + i % 2; j++) {
+            query += ' ' + make_word(ranks(rng));
+        }
+
+        queries.push_back(query);
+    }
+
+    return queries;
+}
+
+/**
+ * Replays every query in a mode
+ * @param query: query engine to replay against
+ * @param queries: queries to replay
+ * @param mode: how queries are run
+ * @param budget: postings budget of SAAT_BUDGET
+ * @param use_page_rank: whether to include pagerank or not in scoring
+ * @return outcome of every query, in order
+*/
+vector<Sample> replay(const Query& query, const vector<string>& queries, Mode mode, long budget, bool use_page_rank) {
+    vector<Sample> samples;
+
+    for (const string& input: queries) {
+        auto start = std::chrono::steady_clock::now();
+        vector<string> tokens = query.tokenize_input(input);
+        AnytimeStats stats;
+        vector<pair<int, double>> results;
+
+        if (mode == TAAT) {
+            results = query.top_documents(*query.calculate_scores(tokens, use_page_rank), 10);
+        }
+        else {
+            results = query.anytime_top_documents(tokens, 10, use_page_rank, &stats, mode == SAAT ? 0 : budget);
+        }
+
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        Sample sample{elapsed.count(), mode == TAAT ? 1 : (double) stats.postings / max(stats.total, 1L), stats.stable, {}};
+
+        for (const auto& result: results) {
+            sample.docs.push_back(result.first);
+        }
+
+        samples.push_back(sample);
+    }
+
+    return samples;
+}
+
+/**
+ * Prints latencies, postings processed and agreement with term-at-a-time of some samples
+ * @param label: name of the row
+ * @param samples: outcome of every query
+ * @param exact: outcome of every query term-at-a-time
+*/
+void report(const string& label, const vector<Sample>& samples, const vector<Sample>& exact) {
+    vector<double> latencies;
+    double processed = 0;
+    long stable = 0;
+    double overlap = 0;
+    long ranked = 0; // queries with any results term-at-a-time
+    long identical = 0;
+
+    for (size_t q = 0; q < samples.size(); q++) {
+        latencies.push_back(samples[q].micros);
+        processed += samples[q].processed;
+        stable += samples[q].stable;
+
+        if (exact[q].docs.empty()) {
+            continue;
+        }
+
+        set<int> found(samples[q].docs.begin(), samples[q].docs.end());
+        int common = 0;
+
+        for (int doc: exact[q].docs) {
+            common += found.count(doc);
+        }
+
+        overlap += (double) common / exact[q].docs.size();
+        identical += samples[q].docs == exact[q].docs;
+        ranked++;
+    }
+
+    sort(latencies.begin(), latencies.end());
+    long queries = max((long) samples.size(), 1L);
+    ranked = max(ranked, 1L);
+    cout << setw(22) << label << setw(10) << percentile(latencies, 50) << setw(10) << percentile(latencies, 99)
+         << setw(10) << latencies.back() << setw(11) << 100 * processed / queries << '%' << setw(9) << 100.0 * stable / queries << '%'
+         << setw(9) << 100 * overlap / ranked << '%' << setw(9) << 100.0 * identical / ranked << "%\n";
+}
+
+int main(int argc, char** argv) {
+    CorpusOptions options;
+    options.pages = 20000;
+    string corpus_path = "";
+    string queries_path = "";
+    int num_queries = 2000;
+    long budget = 5000;
+    IndexConfig config;
+    config.threads = max(1u, thread::hardware_concurrency());
+    config.impact_order = true;
+    config.impact_bits = 8;
+    bool use_page_rank = true;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i];
+        const char* value = argv[i + 1];
+
+        if (flag == "--corpus") corpus_path = value;
+        else if (flag == "--pages") options.pages = atoi(value);
+        else if (flag == "--queries") queries_path = value;
+        else if (flag == "--num-queries") num_queries = atoi(value);
+        else if (flag == "--budget") budget = max(1L, atol(value));
+        else if (flag == "--impact-bits") config.impact_bits = atoi(value) == 16 ? 16 : 8;
+        else if (flag == "--pagerank") use_page_rank = string(value) != "off";
+        else if (flag == "--threads") config.threads = atoi(value);
+        else {
+            cout << "unknown flag " << flag << '\n';
+            return 1;
+        }
+    }
+
+    if (corpus_path.empty()) {
+        corpus_path = "/tmp/anytime_bench.xml";
+        generate_corpus(options, corpus_path);
+    }
+
+    if (queries_path.empty()) {
+        queries_path = "/tmp/anytime_bench_queries.txt";
+        generate_queries(options, num_queries, queries_path);
+    }
+
+    vector<string> log;
+    ifstream file(queries_path);
+    string line;
+
+    while (getline(file, line)) {
+        if (!line.empty()) {
+            log.push_back(line);
+        }
+    }
+
+    if (log.empty()) {
+        cout << "no queries in " << queries_path << '\n';
+        return 1;
+    }
+
+    start_timer();
+    Query query(corpus_path, config);
+    cout << "indexed " << corpus_path << " with " << config.impact_bits << " bit impacts in " << elapsed_seconds()
+         << "s, postings " << query.counter(POSTINGS_BYTES) / 1e6 << " MB with the impact ordered copy, postings budget " << budget
+         << ", pagerank " << (use_page_rank ? "on" : "off") << '\n';
+    cout << fixed << setprecision(1);
+
+    vector<pair<string, vector<string>>> query_sets = {{"query log", log}, {"common words", common_word_queries(log.size(), 20)}};
+
+    for (const auto& query_set: query_sets) {
+        vector<Sample> exact = replay(query, query_set.second, TAAT, budget, use_page_rank);
+
+        cout << '\n' << query_set.first << ", " << query_set.second.size() << " queries, latencies in microseconds\n";
+        cout << "                  mode       p50       p99       max  processed  settled  overlap  same list\n";
+        report("term-at-a-time", exact, exact);
+        report("score-at-a-time", replay(query, query_set.second, SAAT, budget, use_page_rank), exact);
+        report("score-at-a-time budget", replay(query, query_set.second, SAAT_BUDGET, budget, use_page_rank), exact);
+    }
+}
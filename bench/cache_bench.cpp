@@ -0,0 +1,151 @@
+#include "query.hpp"
+#include "bench/corpus_generator.hpp"
+#include <fstream>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+using std::ifstream;
+using std::atomic;
+using std::setw;
+using std::fixed;
+using std::setprecision;
+
+// Result cache benchmark: indexes a corpus, then replays a query log, whose words are as skewed as the
+// corpus's so head queries repeat, at a given concurrency through result caches of several sizes, from
+// none at all. Reports QPS, latency percentiles, hit rate, evictions and the memory the cache took.
+//
+// usage: bench/cache_bench [--corpus PATH | --pages N] [--queries PATH | --num-queries N]
+//                          [--concurrency N] [--repeat N] [--cache-mb N] [--threads N]
+
+/**
+ * Finds a percentile of sorted latencies
+ * @param sorted: latencies, sorted ascending
+ * @param p: percentile, in [0, 100]
+ * @return latency at that percentile
+*/
+double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    size_t i = (size_t) (p / 100 * (sorted.size() - 1) + 0.5);
+
+    return sorted[min(i, sorted.size() - 1)];
+}
+
+/**
+ * Replays every query of the log on a number of threads, ranking through the query engine's cache
+ * @param query: query engine to replay against
+ * @param queries: query log
+ * @param concurrency: number of threads replaying queries
+ * @param repeat: times the log is replayed
+ * @param seconds: set to the wall time of the replay
+ * @return latency of every query replayed, in microseconds
+*/
+vector<double> replay(const Query& query, const vector<string>& queries, int concurrency, int repeat, double& seconds) {
+    long total = (long) queries.size() * repeat;
+    vector<vector<double>> thread_latencies(concurrency);
+    vector<thread> threads;
+    atomic<long> next(0);
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < concurrency; i++) {
+        threads.emplace_back([&, i]() {
+            for (long q = next++; q < total; q = next++) {
+                auto query_start = std::chrono::steady_clock::now();
+                query.top_results(query.tokenize_input(queries[q % queries.size()]), 10, true);
+                std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - query_start;
+                thread_latencies[i].push_back(elapsed.count());
+            }
+        });
+    }
+
+    for (auto& t: threads) {
+        t.join();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    seconds = elapsed.count();
+    vector<double> latencies;
+
+    for (const auto& l: thread_latencies) {
+        latencies.insert(latencies.end(), l.begin(), l.end());
+    }
+
+    return latencies;
+}
+
+int main(int argc, char** argv) {
+    CorpusOptions options;
+    string corpus_path = "";
+    string queries_path = "";
+    int num_queries = 10000;
+    int concurrency = max(1u, thread::hardware_concurrency());
+    int repeat = 3;
+    long cache_mb = 16;
+    int threads = max(1u, thread::hardware_concurrency());
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i];
+        const char* value = argv[i + 1];
+
+        if (flag == "--corpus") corpus_path = value;
+        else if (flag == "--pages") options.pages = atoi(value);
+        else if (flag == "--queries") queries_path = value;
+        else if (flag == "--num-queries") num_queries = atoi(value);
+        else if (flag == "--concurrency") concurrency = max(1, atoi(value));
+        else if (flag == "--repeat") repeat = max(1, atoi(value));
+        else if (flag == "--cache-mb") cache_mb = max(1L, atol(value));
+        else if (flag == "--threads") threads = atoi(value);
+        else {
+            cout << "unknown flag " << flag << '\n';
+            return 1;
+        }
+    }
+
+    if (corpus_path.empty()) {
+        corpus_path = "/tmp/cache_bench.xml";
+        generate_corpus(options, corpus_path);
+    }
+
+    if (queries_path.empty()) {
+        queries_path = "/tmp/cache_bench_queries.txt";
+        generate_queries(options, num_queries, queries_path);
+    }
+
+    vector<string> queries;
+    ifstream file(queries_path);
+    string line;
+
+    while (getline(file, line)) {
+        if (!line.empty()) {
+            queries.push_back(line);
+        }
+    }
+
+    if (queries.empty()) {
+        cout << "no queries in " << queries_path << '\n';
+        return 1;
+    }
+
+    start_timer();
+    Query query(corpus_path, IndexConfig{threads});
+    cout << "indexed " << corpus_path << " in " << elapsed_seconds() << "s, replaying " << queries.size()
+         << " queries x" << repeat << " on " << concurrency << " threads, caches of at most " << cache_mb << " MB\n";
+    cout << fixed << setprecision(1);
+    cout << "\nlatencies in microseconds\n";
+    cout << "       entries        qps       p50       p99      p999  hit rate   evicted        KB\n";
+
+    for (long entries: {0L, 256L, 4096L, 65536L}) {
+        ResultCache cache(entries, cache_mb << 20);
+        query.attach_cache(cache);
+        double seconds = 0;
+        vector<double> latencies = replay(query, queries, concurrency, repeat, seconds);
+        sort(latencies.begin(), latencies.end());
+        CacheStats stats = cache.stats();
+        long lookups = max(1L, stats.hits + stats.misses);
+        cout << setw(14) << entries << setw(11) << latencies.size() / seconds << setw(10) << percentile(latencies, 50)
+             << setw(10) << percentile(latencies, 99) << setw(10) << percentile(latencies, 99.9)
+             << setw(9) << 100.0 * stats.hits / lookups << '%' << setw(10) << stats.evictions << setw(10) << stats.bytes / 1024 << '\n';
+    }
+}
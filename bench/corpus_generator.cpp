@@ -0,0 +1,135 @@
+#include "corpus_generator.hpp"
+#include <fstream>
+#include <random>
+#include <cmath>
+#include <vector>
+using std::ofstream;
+using std::vector;
+using std::mt19937;
+using std::discrete_distribution;
+using std::uniform_int_distribution;
+using std::uniform_real_distribution;
+using std::geometric_distribution;
+
+/**
+ * Makes up a pronounceable word for a given vocabulary rank
+ * @param rank: rank of the word, 0 being the most frequent
+ * @return the word
+*/
+string make_word(int rank) {
+    static const char* syllables[] = {"ka", "lo", "mi", "ne", "ru", "sa", "to", "vi", "ze", "po", "qua", "bri", "dor", "fen", "gul", "hax"};
+    string word = "x"; // keeps made up words clear of the stop words
+
+    do {
+        word += syllables[rank % 16];
+        rank /= 16;
+    } while (rank > 0);
+
+    return word;
+}
+
+/**
+ * Writes a synthetic wiki corpus in the format of the real ones
+ * @param options: shape of the corpus
+ * @param path: where to write the xml
+ * @return totals of the corpus written
+*/
+CorpusStats generate_corpus(const CorpusOptions& options, const string& path) {
+    ofstream file(path);
+    mt19937 rng(options.seed);
+    vector<string> vocabulary;
+    vector<double> weights;
+    CorpusStats stats;
+
+    for (int i = 0; i < options.vocabulary; i++) {
+        vocabulary.push_back(make_word(i));
+        weights.push_back(1.0 / pow(i + 1, options.zipf));
+    }
+
+    discrete_distribution<int> zipf(weights.begin(), weights.end());
+    vector<double> popularity;
+
+    for (int i = 0; i < options.pages; i++) {
+        popularity.push_back(1.0 / pow(i + 1, options.link_skew));
+    }
+
+    discrete_distribution<int> targets(popularity.begin(), popularity.end());
+    geometric_distribution<int> degrees(1.0 / (options.links_per_page + 1));
+    uniform_int_distribution<int> categories(0, options.categories - 1);
+    uniform_real_distribution<double> coin(0, 1);
+    file << "<xml>\n";
+
+    for (int page = 0; page < options.pages; page++) {
+        vector<string> words;
+
+        for (int i = 0; i < options.words_per_page; i++) {
+            words.push_back(vocabulary[zipf(rng)]);
+        }
+
+        file << "<page>\n<title>Page " << page << "</title>\n<id>" << page << "</id>\n<text>";
+
+        int degree = options.links_per_page > 0 ? degrees(rng) : 0;
+
+        for (int i = 0; i < degree; i++) {
+            file << "[[Page " << targets(rng);
+
+            if (coin(rng) < options.piped_links) {
+                file << '|' << vocabulary[zipf(rng)] << ' ' << vocabulary[zipf(rng)];
+            }
+
+            file << "]] ";
+        }
+
+        for (int i = 0; i < options.categories_per_page && options.categories > 0; i++) {
+            file << "[[Category:Topic " << categories(rng) << "]] ";
+        }
+
+        for (int r = 0; r < options.repeat; r++) {
+            for (const string& word: words) {
+                file << word << ' ';
+            }
+        }
+
+        file << "</text>\n</page>\n";
+        stats.pages++;
+        stats.words += (long) words.size() * options.repeat;
+        stats.links += degree;
+        stats.category_links += options.categories > 0 ? options.categories_per_page : 0;
+    }
+
+    file << "</xml>\n";
+
+    return stats;
+}
+
+
+/**
+ * Writes a query log for a synthetic corpus, one query of 1 to 3 words per line, with the
+ * same zipfian vocabulary as the corpus (half of the queries are single words)
+ * @param options: shape of the corpus the queries are for
+ * @param count: number of queries
+ * @param path: where to write the queries
+*/
+void generate_queries(const CorpusOptions& options, int count, const string& path) {
+    ofstream file(path);
+    mt19937 rng(options.seed + 1);
+    vector<double> weights;
+
+    for (int i = 0; i < options.vocabulary; i++) {
+        weights.push_back(1.0 / pow(i + 1, options.zipf));
+    }
+
+    discrete_distribution<int> zipf(weights.begin(), weights.end());
+    uniform_int_distribution<int> lengths(2, 3);
+    uniform_real_distribution<double> coin(0, 1);
+
+    for (int i = 0; i < count; i++) {
+        int length = coin(rng) < 0.5 ? 1 : lengths(rng);
+
+        for (int j = 0; j < length; j++) {
+            file << (j > 0 ? " " : "") << make_word(zipf(rng));
+        }
+
+        file << '\n';
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef CORPUS_GENERATOR_H
+#define CORPUS_GENERATOR_H
+
+#include <string>
+using std::string;
+
+// shape of a synthetic wiki corpus
+struct CorpusOptions {
+    int pages = 1000; // number of pages
+    int words_per_page = 300; // words in the text of each page, before repetition
+    int vocabulary = 50000; // number of distinct words
+    double zipf = 1.0; // exponent of the zipfian word distribution
+    int links_per_page = 10; // average links from each page to other pages, geometrically distributed
+    double link_skew = 1.0; // exponent of the zipfian popularity of link targets, 0 for uniform
+    double piped_links = 0.2; // fraction of links written as [[target|text]]
+    int categories = 100; // number of distinct categories
+    int categories_per_page = 2; // category links of each page
+    int repeat = 1; // times the words of each page's text are repeated (same distinct words, more tokens)
+    unsigned int seed = 42; // seed of the random generator
+};
+
+// totals of a generated corpus
+struct CorpusStats {
+    long pages = 0;
+    long words = 0; // words written, not counting links
+    long links = 0; // links between pages
+    long category_links = 0;
+};
+
+string make_word(int rank);
+CorpusStats generate_corpus(const CorpusOptions& options, const string& path);
+void generate_queries(const CorpusOptions& options, int count, const string& path);
+
+#endif // CORPUS_GENERATOR_H
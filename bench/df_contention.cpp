@@ -0,0 +1,185 @@
+#include <unordered_map>
+#include <string>
+#include <array>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <functional>
+using std::unordered_map;
+using std::string;
+using std::array;
+using std::vector;
+using std::thread;
+using std::mutex;
+using std::atomic;
+using std::mt19937;
+using std::discrete_distribution;
+using std::cout;
+using std::hash;
+
+// Contention benchmark for document frequency counting: the old scheme (26 mutex-guarded maps,
+// bucketed by first letter) against thread-local counts merged by a parallel reduction.
+//
+// usage: bench/df_contention [threads] [docs per thread] [distinct words per doc] [vocabulary size]
+
+// rough frequency of english words by first letter, so the old buckets are as skewed as on a real corpus
+const double FIRST_LETTERS[26] = {
+    11.7, 4.4, 5.2, 3.2, 2.8, 4.0, 1.6, 4.2, 7.3, 0.5, 0.9, 2.4, 3.8,
+    2.3, 7.6, 4.3, 0.2, 2.8, 6.7, 16.0, 1.2, 0.8, 5.5, 0.1, 0.8, 0.1
+};
+
+/**
+ * Generates the distinct words of every document, per thread, with a zipfian vocabulary
+ * @return threads -> docs -> distinct words
+*/
+vector<vector<vector<string>>> generate_docs(int threads, int docs, int words, int vocab) {
+    mt19937 rng(42);
+    discrete_distribution<int> letters(FIRST_LETTERS, FIRST_LETTERS + 26);
+    vector<string> vocabulary;
+    vector<double> weights;
+
+    for (int i = 0; i < vocab; i++) {
+        string word(1, 'a' + letters(rng));
+
+        for (int rank = i; rank > 0; rank /= 26) {
+            word += 'a' + rank % 26;
+        }
+
+        vocabulary.push_back(word);
+        weights.push_back(1.0 / (i + 1));
+    }
+
+    discrete_distribution<int> zipf(weights.begin(), weights.end());
+    vector<vector<vector<string>>> all_docs(threads, vector<vector<string>>(docs));
+
+    for (auto& thread_docs: all_docs) {
+        for (auto& doc: thread_docs) {
+            unordered_map<int, bool> seen;
+
+            while ((int) doc.size() < words && (int) seen.size() < vocab) {
+                int w = zipf(rng);
+
+                if (!seen[w]) {
+                    seen[w] = true;
+                    doc.push_back(vocabulary[w]);
+                }
+            }
+        }
+    }
+
+    return all_docs;
+}
+
+/**
+ * Counts doc frequencies the old way, locking a first-letter bucket for every new word in a doc
+ * @return seconds elapsed
+*/
+double run_sharded(const vector<vector<vector<string>>>& all_docs, long& contended) {
+    array<mutex, 26> word_mutexes;
+    array<unordered_map<string, int>, 26> words_to_doc_counts;
+    atomic<long> total_contended(0);
+    vector<thread> threads;
+    auto start = std::chrono::steady_clock::now();
+
+    for (const auto& thread_docs: all_docs) {
+        threads.emplace_back([&]() {
+            long local_contended = 0;
+
+            for (const auto& doc: thread_docs) {
+                for (const string& word: doc) {
+                    int w_id = (abs(word.front() - 97) % 26) / 2;
+
+                    if (!word_mutexes[w_id].try_lock()) {
+                        local_contended++;
+                        word_mutexes[w_id].lock();
+                    }
+
+                    words_to_doc_counts[w_id][word] += 1;
+                    word_mutexes[w_id].unlock();
+                }
+            }
+
+            total_contended += local_contended;
+        });
+    }
+
+    for (auto& t: threads) {
+        t.join();
+    }
+
+    contended = total_contended;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count();
+}
+
+/**
+ * Counts doc frequencies into thread-local maps split by word partition, then sums every
+ * partition on its own thread
+ * @return seconds elapsed
+*/
+double run_thread_local(const vector<vector<vector<string>>>& all_docs) {
+    int num_threads = all_docs.size();
+    vector<vector<unordered_map<string, int>>> local_counts(num_threads, vector<unordered_map<string, int>>(num_threads));
+    vector<unordered_map<string, int>> words_to_doc_counts(num_threads);
+    vector<thread> threads;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < num_threads; i++) {
+        threads.emplace_back([&, i]() {
+            for (const auto& doc: all_docs[i]) {
+                for (const string& word: doc) {
+                    local_counts[i][hash<string>()(word) % num_threads][word] += 1;
+                }
+            }
+        });
+    }
+
+    for (auto& t: threads) {
+        t.join();
+    }
+
+    threads.clear();
+
+    for (int p = 0; p < num_threads; p++) {
+        threads.emplace_back([&, p]() {
+            for (auto& counts: local_counts) {
+                for (const auto& x: counts[p]) {
+                    words_to_doc_counts[p][x.first] += x.second;
+                }
+            }
+        });
+    }
+
+    for (auto& t: threads) {
+        t.join();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count();
+}
+
+int main(int argc, char** argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : std::max(1u, thread::hardware_concurrency());
+    int docs = argc > 2 ? atoi(argv[2]) : 2000;
+    int words = argc > 3 ? atoi(argv[3]) : 200;
+    int vocab = argc > 4 ? atoi(argv[4]) : 50000;
+
+    cout << "threads  sharded(s)  contended  thread-local(s)  speedup\n";
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        auto all_docs = generate_docs(threads, docs, words, vocab);
+        long contended = 0;
+        double sharded = run_sharded(all_docs, contended);
+        double local = run_thread_local(all_docs);
+
+        cout << threads << "\t " << sharded << "\t     " << contended << "\t\t" << local << "\t   " << sharded / local << "x\n";
+    }
+}
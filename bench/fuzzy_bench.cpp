@@ -0,0 +1,158 @@
+#include "util/levenshtein.hpp"
+#include "bench/corpus_generator.hpp"
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+using std::cout;
+using std::mt19937;
+using std::uniform_int_distribution;
+using std::setw;
+using std::fixed;
+using std::setprecision;
+using std::min;
+
+// Fuzzy lookup benchmark: builds a term dictionary of made up words, then looks up misspellings of
+// its terms (1 or 2 random edits away) with a Levenshtein automaton of edit distance 1 and 2,
+// reporting latency percentiles and matches found, next to scanning every term with the same
+// automaton for a handful of lookups.
+//
+// usage: bench/fuzzy_bench [--terms N] [--lookups N] [--scans N]
+
+/**
+ * Finds a percentile of sorted latencies
+ * @param sorted: latencies, sorted ascending
+ * @param p: percentile, in [0, 100]
+ * @return latency at that percentile
+*/
+double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    size_t i = (size_t) (p / 100 * (sorted.size() - 1) + 0.5);
+
+    return sorted[min(i, sorted.size() - 1)];
+}
+
+/**
+ * Misspells a word with random insertions, deletions and substitutions
+ * @param word: word to misspell
+ * @param edits: number of edits to make
+ * @param rng: random generator
+ * @return the misspelled word
+*/
+string misspell(string word, int edits, mt19937& rng) {
+    uniform_int_distribution<int> letters('a', 'z');
+
+    for (int i = 0; i < edits; i++) {
+        size_t pos = uniform_int_distribution<size_t>(0, word.size() - 1)(rng);
+        int kind = uniform_int_distribution<int>(0, 2)(rng);
+
+        if (kind == 0) {
+            word.insert(word.begin() + pos, (char) letters(rng));
+        }
+        else if (kind == 1 && word.size() > 1) {
+            word.erase(pos, 1);
+        }
+        else {
+            word[pos] = (char) letters(rng);
+        }
+    }
+
+    return word;
+}
+
+/**
+ * Finds the terms an automaton accepts by running it over every term, what the dictionary walk avoids
+ * @param words: every term
+ * @param automaton: automaton of the word to match
+ * @return number of matches
+*/
+long scan_terms(const vector<string>& words, const LevenshteinAutomaton& automaton) {
+    vector<int> state;
+    vector<int> next;
+    long matches = 0;
+
+    for (const string& word: words) {
+        automaton.start(state);
+
+        for (char c: word) {
+            automaton.step(state, c, next);
+            state.swap(next);
+        }
+
+        matches += automaton.is_match(state);
+    }
+
+    return matches;
+}
+
+int main(int argc, char** argv) {
+    int num_terms = 1000000;
+    int num_lookups = 2000;
+    int num_scans = 5;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i];
+        const char* value = argv[i + 1];
+
+        if (flag == "--terms") num_terms = atoi(value);
+        else if (flag == "--lookups") num_lookups = atoi(value);
+        else if (flag == "--scans") num_scans = atoi(value);
+        else {
+            cout << "unknown flag " << flag << '\n';
+            return 1;
+        }
+    }
+
+    vector<string> words;
+
+    for (int i = 0; i < num_terms; i++) {
+        words.push_back(make_word(i));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    TermDictionary dictionary;
+    dictionary.build(words);
+    std::chrono::duration<double> build = std::chrono::steady_clock::now() - start;
+    cout << fixed << setprecision(1);
+    cout << "dictionary: " << dictionary.size() << " terms, " << dictionary.memory_bytes() / 1e6 << " MB, built in "
+         << build.count() << "s\n\n";
+    cout << "edits  lookups   matches/lookup       p50(us)       p99(us)       max(us)  full scan(us)\n";
+    mt19937 rng(11);
+
+    for (int edits: {1, 2}) {
+        vector<string> queries;
+
+        for (int i = 0; i < num_lookups; i++) {
+            const string& word = words[uniform_int_distribution<int>(0, num_terms - 1)(rng)];
+            queries.push_back(misspell(word, uniform_int_distribution<int>(1, edits)(rng), rng));
+        }
+
+        vector<double> latencies;
+        long matches = 0;
+
+        for (const string& query: queries) {
+            auto lookup_start = std::chrono::steady_clock::now();
+            matches += fuzzy_terms(dictionary, LevenshteinAutomaton(query, edits)).size();
+            std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - lookup_start;
+            latencies.push_back(elapsed.count());
+        }
+
+        double scan_micros = 0;
+
+        for (int i = 0; i < num_scans && i < (int) queries.size(); i++) {
+            auto scan_start = std::chrono::steady_clock::now();
+            scan_terms(words, LevenshteinAutomaton(queries[i], edits));
+            std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - scan_start;
+            scan_micros += elapsed.count() / min(num_scans, (int) queries.size());
+        }
+
+        sort(latencies.begin(), latencies.end());
+        cout << setw(5) << edits << setw(9) << queries.size() << setw(17) << (double) matches / queries.size()
+             << setw(14) << percentile(latencies, 50) << setw(14) << percentile(latencies, 99)
+             << setw(14) << latencies.back() << setw(15) << scan_micros << '\n';
+    }
+}
@@ -0,0 +1,189 @@
+#include "query.hpp"
+#include "bench/corpus_generator.hpp"
+#include <fstream>
+#include <iomanip>
+#include <set>
+using std::ifstream;
+using std::set;
+using std::setw;
+using std::fixed;
+using std::setprecision;
+
+// Impact quantization evaluation: indexes a corpus with exact scores and with scores quantized to
+// 16 and 8 bit impacts (one scale per term, then one for the whole index), replays a query log on
+// each and reports how far the quantized top k agree with the exact one, next to the postings memory.
+// Agreement is the fraction of the exact top k found in the quantized top k, how often both top k
+// are the same list in the same order, and how often they have the same best document.
+//
+// usage: bench/impact_eval [--corpus PATH | --pages N] [--queries PATH | --num-queries N] [--k N]
+//                          [--scoring tfidf|bm25|bm25f] [--pagerank on|off|both] [--threads N]
+
+// a way of storing posting scores
+struct Variant {
+    string name;
+    int impact_bits;
+    bool global_scale;
+};
+
+// top k of every query of the log, under one variant and one pagerank setting
+using Rankings = vector<vector<int>>;
+
+/**
+ * Ranks every query of the log
+ * @param query: query engine to replay against
+ * @param queries: query log
+ * @param k: number of documents ranked per query
+ * @param use_page_rank: whether to include pagerank or not in scoring
+ * @return dense doc ids of the top k of every query, best first
+*/
+Rankings rank_queries(const Query& query, const vector<string>& queries, int k, bool use_page_rank) {
+    Rankings rankings;
+
+    for (const string& input: queries) {
+        vector<int> docs;
+
+        for (const auto& result: query.top_documents(*query.calculate_scores(query.tokenize_input(input), use_page_rank), k)) {
+            docs.push_back(result.first);
+        }
+
+        rankings.push_back(docs);
+    }
+
+    return rankings;
+}
+
+/**
+ * Prints how far rankings agree with the exact ones
+ * @param label: name of the row
+ * @param exact: rankings with exact scores
+ * @param approximate: rankings with quantized scores, of the same queries
+ * @param postings_mb: memory of the quantized postings
+ * @param exact_mb: memory of the exact postings
+*/
+void report(const string& label, const Rankings& exact, const Rankings& approximate, double postings_mb, double exact_mb) {
+    double overlap = 0;
+    long ranked = 0; // queries with any exact results
+    long identical = 0;
+    long same_best = 0;
+
+    for (size_t q = 0; q < exact.size(); q++) {
+        if (exact[q].empty()) {
+            continue;
+        }
+
+        set<int> found(approximate[q].begin(), approximate[q].end());
+        int common = 0;
+
+        for (int doc: exact[q]) {
+            common += found.count(doc);
+        }
+
+        overlap += (double) common / exact[q].size();
+        ranked++;
+        identical += exact[q] == approximate[q];
+        same_best += !approximate[q].empty() && approximate[q][0] == exact[q][0];
+    }
+
+    ranked = max(ranked, 1L);
+    cout << setw(18) << label << setw(12) << postings_mb << setw(9) << exact_mb / max(postings_mb, 1e-9) << 'x'
+         << setw(11) << 100 * overlap / ranked << '%' << setw(11) << 100.0 * identical / ranked << '%'
+         << setw(10) << 100.0 * same_best / ranked << "%\n";
+}
+
+int main(int argc, char** argv) {
+    CorpusOptions options;
+    string corpus_path = "";
+    string queries_path = "";
+    int num_queries = 2000;
+    int k = 10;
+    IndexConfig config;
+    config.threads = max(1u, thread::hardware_concurrency());
+    string page_rank = "both";
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i];
+        const char* value = argv[i + 1];
+
+        if (flag == "--corpus") corpus_path = value;
+        else if (flag == "--pages") options.pages = atoi(value);
+        else if (flag == "--queries") queries_path = value;
+        else if (flag == "--num-queries") num_queries = atoi(value);
+        else if (flag == "--k") k = max(1, atoi(value));
+        else if (flag == "--scoring") {
+            if (!parse_scoring(value, config.scoring)) {
+                cout << "unknown scoring function " << value << '\n';
+                return 1;
+            }
+        }
+        else if (flag == "--pagerank") page_rank = value;
+        else if (flag == "--threads") config.threads = atoi(value);
+        else {
+            cout << "unknown flag " << flag << '\n';
+            return 1;
+        }
+    }
+
+    if (corpus_path.empty()) {
+        corpus_path = "/tmp/impact_eval.xml";
+        generate_corpus(options, corpus_path);
+    }
+
+    if (queries_path.empty()) {
+        queries_path = "/tmp/impact_eval_queries.txt";
+        generate_queries(options, num_queries, queries_path);
+    }
+
+    vector<string> queries;
+    ifstream file(queries_path);
+    string line;
+
+    while (getline(file, line)) {
+        if (!line.empty()) {
+            queries.push_back(line);
+        }
+    }
+
+    if (queries.empty()) {
+        cout << "no queries in " << queries_path << '\n';
+        return 1;
+    }
+
+    vector<Variant> variants = {
+        {"exact", 0, false}, {"16-bit term", 16, false}, {"16-bit global", 16, true}, {"8-bit term", 8, false}, {"8-bit global", 8, true}
+    };
+    vector<bool> page_rank_settings;
+
+    for (bool use_page_rank: {true, false}) {
+        if (!(use_page_rank && page_rank == "off") && !(!use_page_rank && page_rank == "on")) {
+            page_rank_settings.push_back(use_page_rank);
+        }
+    }
+
+    // one index at a time, so only one is ever in memory
+    vector<vector<Rankings>> rankings(variants.size()); // variants -> pagerank settings -> rankings
+    vector<double> postings_mb(variants.size());
+
+    for (size_t v = 0; v < variants.size(); v++) {
+        config.impact_bits = variants[v].impact_bits;
+        config.global_scale = variants[v].global_scale;
+        Query query(corpus_path, config);
+        postings_mb[v] = query.counter(POSTINGS_BYTES) / 1e6;
+
+        for (bool use_page_rank: page_rank_settings) {
+            rankings[v].push_back(rank_queries(query, queries, k, use_page_rank));
+        }
+    }
+
+    cout << "indexed " << corpus_path << ", replayed " << queries.size() << " queries, agreement of the top " << k << " with exact scores\n";
+    cout << fixed << setprecision(1);
+
+    for (size_t p = 0; p < page_rank_settings.size(); p++) {
+        cout << "\npagerank " << (page_rank_settings[p] ? "on" : "off") << '\n';
+        cout << setw(18) << "postings" << setw(12) << "memory MB" << setw(10) << "smaller" << setw(12) << "overlap"
+             << setw(12) << "same list" << setw(11) << "same best" << '\n';
+
+        for (size_t v = 0; v < variants.size(); v++) {
+            report(variants[v].name, rankings[0][p], rankings[v][p], postings_mb[v], postings_mb[0]);
+        }
+    }
+}
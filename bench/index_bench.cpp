@@ -0,0 +1,161 @@
+#include "index.hpp"
+#include "bench/corpus_generator.hpp"
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstring>
+#include <iomanip>
+#include <fstream>
+using std::cout;
+using std::cerr;
+using std::setw;
+using std::fixed;
+using std::setprecision;
+
+// Indexing benchmark: generates a synthetic wiki corpus, then indexes it with 1, 2, 4, ... up to
+// --threads worker threads, reporting the wall time of every phase, throughput and peak RSS. Every
+// thread count is indexed in a process of its own, so its peak RSS isn't that of an earlier run.
+//
+// usage: bench/index_bench [--pages N] [--words N] [--vocabulary N] [--zipf S] [--links N]
+//                          [--link-skew S] [--categories N] [--categories-per-page N]
+//                          [--threads N] [--shards N] [--corpus PATH] [--metrics PATH]
+
+static const char* USAGE = "usage: bench/index_bench [--pages N] [--words N] [--vocabulary N] [--zipf S] [--links N]\n"
+                           "                         [--link-skew S] [--categories N] [--categories-per-page N]\n"
+                           "                         [--threads N] [--shards N] [--corpus PATH] [--metrics PATH]\n";
+
+/**
+ * Reads the peak resident set size of this process
+ * @return peak RSS in MB
+*/
+double peak_rss_mb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_maxrss / 1024.0; // ru_maxrss is in KB on linux
+}
+
+/**
+ * Indexes a corpus, timing each phase, and prints one row of the report
+ * @param path: corpus to index
+ * @param threads: number of worker threads
+ * @param shards: number of word partitions and term buckets, 0 for the default
+ * @param stats: totals of the corpus
+ * @param metrics_path: where to write the indexer's json metrics report, if not empty
+*/
+void index_corpus(const string& path, int threads, int shards, const CorpusStats& stats, const string& metrics_path) {
+    Index index(path, IndexConfig{threads, shards});
+    double times[5];
+
+    start_timer();
+    if (index.ingest_pages() != 0) {
+        cout << "could not load " << path << '\n';
+        exit(1);
+    }
+    times[0] = elapsed_seconds();
+
+    start_timer();
+    index.batch_links();
+    times[1] = elapsed_seconds();
+
+    start_timer();
+    index.batch_relevance();
+    times[2] = elapsed_seconds();
+
+    start_timer();
+    index.batch_weights();
+    times[3] = elapsed_seconds();
+
+    start_timer();
+    index.calculate_page_ranks();
+    times[4] = elapsed_seconds();
+
+    double total = 0;
+    cout << setw(7) << threads;
+
+    for (double time: times) {
+        cout << setw(11) << time;
+        total += time;
+    }
+
+    cout << setw(11) << total << setw(11) << (long) (stats.pages / times[0]) << setw(12) << (long) (index.counter(TOKENS) / times[0])
+         << setw(10) << peak_rss_mb() << '\n';
+
+    if (!metrics_path.empty()) {
+        std::ofstream(metrics_path) << index.metrics_json(); // the last run wins
+    }
+}
+
+/**
+ * Indexes a corpus in a child process, so the peak RSS it reports is its own, and waits for it
+ * @param path: corpus to index
+ * @param threads: number of worker threads
+ * @param shards: number of word partitions and term buckets, 0 for the default
+ * @param stats: totals of the corpus
+ * @param metrics_path: where to write the indexer's json metrics report, if not empty
+*/
+void run(const string& path, int threads, int shards, const CorpusStats& stats, const string& metrics_path) {
+    cout.flush(); // or the child prints it again
+    pid_t child = fork();
+
+    if (child == 0) {
+        index_corpus(path, threads, shards, stats, metrics_path);
+        cout.flush();
+        _exit(0);
+    }
+
+    int status = 0;
+
+    if (child < 0 || waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        cout << "indexing with " << threads << " threads failed\n";
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv) {
+    CorpusOptions options;
+    string path = "/tmp/index_bench.xml";
+    string metrics_path = "";
+    int max_threads = max(1u, thread::hardware_concurrency());
+    int shards = 0;
+
+    for (int i = 1; i < argc; i += 2) {
+        string flag = argv[i];
+
+        if (i + 1 == argc) {
+            cerr << "missing value of " << flag << '\n' << USAGE;
+            return 1;
+        }
+
+        const char* value = argv[i + 1];
+
+        if (flag == "--pages") options.pages = atoi(value);
+        else if (flag == "--words") options.words_per_page = atoi(value);
+        else if (flag == "--vocabulary") options.vocabulary = atoi(value);
+        else if (flag == "--zipf") options.zipf = atof(value);
+        else if (flag == "--links") options.links_per_page = atoi(value);
+        else if (flag == "--link-skew") options.link_skew = atof(value);
+        else if (flag == "--categories") options.categories = atoi(value);
+        else if (flag == "--categories-per-page") options.categories_per_page = atoi(value);
+        else if (flag == "--threads") max_threads = atoi(value);
+        else if (flag == "--shards") shards = atoi(value);
+        else if (flag == "--corpus") path = value;
+        else if (flag == "--metrics") metrics_path = value;
+        else {
+            cerr << "unknown flag " << flag << '\n' << USAGE;
+            return 1;
+        }
+    }
+
+    CorpusStats stats = generate_corpus(options, path);
+    cout << "corpus: " << path << ", " << stats.pages << " pages, " << stats.words << " words, "
+         << stats.links << " links, " << stats.category_links << " category links\n";
+    cout << fixed << setprecision(3);
+    cout << "threads     ingest      links  relevance    weights  pageranks      total    pages/s    tokens/s   rss(MB)\n";
+
+    for (int threads = 1; threads < max_threads; threads *= 2) {
+        run(path, threads, shards, stats, metrics_path);
+    }
+
+    run(path, max_threads, shards, stats, metrics_path);
+}
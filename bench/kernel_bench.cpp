@@ -0,0 +1,203 @@
+#include "util/score_kernels.hpp"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <queue>
+#include <functional>
+#include <cstring>
+using std::cout;
+using std::vector;
+using std::string;
+using std::mt19937;
+using std::uniform_real_distribution;
+using std::uniform_int_distribution;
+using std::priority_queue;
+using std::greater;
+using std::function;
+using std::setw;
+using std::fixed;
+using std::setprecision;
+
+// Scoring kernel microbenchmark: times the scalar reference and the AVX2 version of every kernel of
+// util/score_kernels on posting lists of realistic lengths, from a rare term's to a stop word's, over
+// an accumulator array the size of a corpus, and checks both versions give the same bits.
+//
+// usage: bench/kernel_bench [--docs N] [--repeat N]
+
+// postings of one synthetic term
+struct TermList {
+    vector<int> docs; // dense doc ids, ascending
+    vector<double> scores;
+    vector<uint8_t> impacts8;
+    vector<uint16_t> impacts16;
+};
+
+/**
+ * Makes the postings of a term in about some number of docs, every doc as likely as any other
+ * @param num_docs: docs in the corpus
+ * @param length: docs the term should be in
+ * @param rng: random generator
+ * @return the postings
+*/
+TermList make_list(int num_docs, int length, mt19937& rng) {
+    TermList list;
+    uniform_real_distribution<double> coin(0, 1);
+    uniform_int_distribution<int> impacts(1, 65535);
+    double p = (double) length / num_docs;
+
+    for (int doc = 0; doc < num_docs; doc++) {
+        if (coin(rng) < p) {
+            int impact = impacts(rng);
+            list.docs.push_back(doc);
+            list.scores.push_back(coin(rng));
+            list.impacts8.push_back(impact >> 8 | 1);
+            list.impacts16.push_back(impact);
+        }
+    }
+
+    return list;
+}
+
+/**
+ * Times a kernel
+ * @param run: runs the kernel once
+ * @param repeat: times to run it
+ * @return nanoseconds a run, the best of the runs
+*/
+double time_kernel(const function<void()>& run, int repeat) {
+    double best = 1e18;
+
+    for (int i = 0; i < repeat; i++) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+
+    return best;
+}
+
+/**
+ * Prints the timings of both versions of a kernel and whether they agree
+ * @param label: name of the row
+ * @param elements: elements a run processes, to report nanoseconds an element
+ * @param scalar_ns: nanoseconds a run of the scalar version
+ * @param avx2_ns: nanoseconds a run of the AVX2 version
+ * @param same: whether both versions gave the same bits
+*/
+void report(const string& label, long elements, double scalar_ns, double avx2_ns, bool same) {
+    cout << setw(26) << label << setw(10) << elements << setw(12) << scalar_ns / elements << setw(12) << avx2_ns / elements
+         << setw(9) << scalar_ns / avx2_ns << 'x' << setw(7) << (same ? "yes" : "NO") << '\n';
+}
+
+/**
+ * Finds the top 10 of an accumulator array the way Query::top_documents does, jumping from one
+ * score above the threshold to the next
+ * @param scores: accumulators
+ * @param n: number of accumulators
+ * @param next: next_above kernel to scan with
+ * @return sum of the top 10 scores, so the scan can't be optimized away
+*/
+double top10(const double* scores, size_t n, size_t (*next)(const double*, size_t, size_t, double)) {
+    priority_queue<double, vector<double>, greater<double>> top; // worst of the top 10 on top
+    auto threshold = [&]() { return top.size() < 10 ? 0 : top.top(); };
+
+    for (size_t doc = next(scores, 0, n, threshold()); doc < n; doc = next(scores, doc + 1, n, threshold())) {
+        top.push(scores[doc]);
+
+        if (top.size() > 10) {
+            top.pop();
+        }
+    }
+
+    double sum = 0;
+
+    for (; !top.empty(); top.pop()) {
+        sum += top.top();
+    }
+
+    return sum;
+}
+
+int main(int argc, char** argv) {
+    int num_docs = 1000000;
+    int repeat = 20;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i];
+        const char* value = argv[i + 1];
+
+        if (flag == "--docs") num_docs = std::max(1000, atoi(value));
+        else if (flag == "--repeat") repeat = std::max(1, atoi(value));
+        else {
+            cout << "unknown flag " << flag << '\n';
+            return 1;
+        }
+    }
+
+    mt19937 rng(5);
+    vector<double> scalar_acc(num_docs);
+    vector<double> avx2_acc(num_docs);
+    auto same = [&]() { return memcmp(scalar_acc.data(), avx2_acc.data(), num_docs * sizeof(double)) == 0; };
+
+    cout << num_docs << " docs, " << (has_avx2() ? "AVX2" : "no AVX2, both versions are scalar") << ", best of " << repeat << " runs\n";
+    cout << "                    kernel  elements   scalar ns     avx2 ns  speedup  same\n";
+    cout << fixed << setprecision(2);
+
+    for (int length: {100, 1000, 10000, 100000, num_docs / 2}) {
+        TermList list = make_list(num_docs, length, rng);
+        size_t n = list.docs.size();
+        const int* docs = list.docs.data();
+        string suffix = " (" + std::to_string(length) + ")";
+        double scalar_ns = time_kernel([&]() { add_scores_scalar(scalar_acc.data(), docs, list.scores.data(), n); }, repeat);
+        double avx2_ns = time_kernel([&]() { add_scores_avx2(avx2_acc.data(), docs, list.scores.data(), n); }, repeat);
+        report("add_scores" + suffix, n, scalar_ns, avx2_ns, same());
+        scalar_ns = time_kernel([&]() { add_impacts8_scalar(scalar_acc.data(), docs, list.impacts8.data(), n, 0.01); }, repeat);
+        avx2_ns = time_kernel([&]() { add_impacts8_avx2(avx2_acc.data(), docs, list.impacts8.data(), n, 0.01); }, repeat);
+        report("add_impacts8" + suffix, n, scalar_ns, avx2_ns, same());
+        scalar_ns = time_kernel([&]() { add_impacts16_scalar(scalar_acc.data(), docs, list.impacts16.data(), n, 1e-4); }, repeat);
+        avx2_ns = time_kernel([&]() { add_impacts16_avx2(avx2_acc.data(), docs, list.impacts16.data(), n, 1e-4); }, repeat);
+        report("add_impacts16" + suffix, n, scalar_ns, avx2_ns, same());
+        scalar_ns = time_kernel([&]() { add_constant_scalar(scalar_acc.data(), docs, n, 0.01); }, repeat);
+        avx2_ns = time_kernel([&]() { add_constant_avx2(avx2_acc.data(), docs, n, 0.01); }, repeat);
+        report("add_constant" + suffix, n, scalar_ns, avx2_ns, same());
+    }
+
+    // page ranks close to 1 so repeated runs don't underflow or overflow
+    vector<double> weights(num_docs);
+    uniform_real_distribution<double> near_one(0.999, 1.001);
+
+    for (double& weight: weights) {
+        weight = near_one(rng);
+    }
+
+    double scalar_ns = time_kernel([&]() { multiply_scores_scalar(scalar_acc.data(), weights.data(), num_docs); }, repeat);
+    double avx2_ns = time_kernel([&]() { multiply_scores_avx2(avx2_acc.data(), weights.data(), num_docs); }, repeat);
+    report("multiply_scores", num_docs, scalar_ns, avx2_ns, same());
+
+    // the accumulators of a query of a common and a rare term: mostly 0, a few large
+    vector<double> query_scores(num_docs, 0);
+
+    for (int length: {num_docs / 10, num_docs / 1000}) {
+        TermList list = make_list(num_docs, length, rng);
+        add_scores_scalar(query_scores.data(), list.docs.data(), list.scores.data(), list.docs.size());
+    }
+
+    double scalar_top = 0;
+    double avx2_top = 0;
+    scalar_ns = time_kernel([&]() { scalar_top = top10(query_scores.data(), num_docs, next_above_scalar); }, repeat);
+    avx2_ns = time_kernel([&]() { avx2_top = top10(query_scores.data(), num_docs, next_above_avx2); }, repeat);
+    report("top 10 scan", num_docs, scalar_ns, avx2_ns, scalar_top == avx2_top);
+
+    // the docs of a common term's segment against a threshold none of them reach, so every one is looked at
+    TermList segment = make_list(num_docs, num_docs / 10, rng);
+    size_t n = segment.docs.size();
+    size_t scalar_next = 0;
+    size_t avx2_next = 0;
+    scalar_ns = time_kernel([&]() { scalar_next = next_reaching_scalar(query_scores.data(), weights.data(), segment.docs.data(), 0, n, 1e300); }, repeat);
+    avx2_ns = time_kernel([&]() { avx2_next = next_reaching_avx2(query_scores.data(), weights.data(), segment.docs.data(), 0, n, 1e300); }, repeat);
+    report("segment scan", n, scalar_ns, avx2_ns, scalar_next == avx2_next);
+}
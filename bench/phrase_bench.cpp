@@ -0,0 +1,214 @@
+#include "query.hpp"
+#include "bench/corpus_generator.hpp"
+#include <random>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+using std::mt19937;
+using std::uniform_int_distribution;
+using std::istringstream;
+using std::setw;
+using std::fixed;
+using std::setprecision;
+
+// Phrase query benchmark: indexes a synthetic corpus without and with positions, reporting the
+// indexing time and how much memory the positions take next to the postings, then replays phrases
+// of 2 and 3 words sampled from the pages' text as bag-of-words, exact phrase and sloppy phrase
+// queries, reporting latency percentiles of each.
+//
+// usage: bench/phrase_bench [--corpus PATH | --pages N] [--phrases N] [--slop N] [--threads N]
+
+// a phrase sampled from the corpus
+struct Phrase {
+    string text; // words of the phrase, space separated
+    int length; // number of words
+};
+
+/**
+ * Finds a percentile of sorted latencies
+ * @param sorted: latencies, sorted ascending
+ * @param p: percentile, in [0, 100]
+ * @return latency at that percentile
+*/
+double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    size_t i = (size_t) (p / 100 * (sorted.size() - 1) + 0.5);
+
+    return sorted[min(i, sorted.size() - 1)];
+}
+
+/**
+ * Samples phrases of 2 and 3 consecutive words from the text of random pages, skipping links
+ * @param path: corpus to sample from
+ * @param count: number of phrases
+ * @return the phrases, half of each length
+*/
+vector<Phrase> sample_phrases(const string& path, int count) {
+    xml_document doc;
+    vector<vector<string>> pages; // words of the text of each page
+
+    if (!doc.load_file(path.c_str())) {
+        return {};
+    }
+
+    for (xml_node page: doc.child("xml").children("page")) {
+        istringstream text(page.child_value("text"));
+        vector<string> words;
+        string word;
+
+        while (text >> word) {
+            if (word.find_first_of("[]|:") != string::npos) {
+                words.clear(); // only keep words after the last link, they're plain text
+            }
+            else {
+                words.push_back(word);
+            }
+        }
+
+        if (words.size() >= 3) {
+            pages.push_back(words);
+        }
+    }
+
+    vector<Phrase> phrases;
+    mt19937 rng(7);
+
+    for (int i = 0; i < count && !pages.empty(); i++) {
+        const vector<string>& words = pages[uniform_int_distribution<size_t>(0, pages.size() - 1)(rng)];
+        int length = 2 + i % 2;
+        size_t start = uniform_int_distribution<size_t>(0, words.size() - length)(rng);
+        Phrase phrase{words[start], length};
+
+        for (int j = 1; j < length; j++) {
+            phrase.text += ' ' + words[start + j];
+        }
+
+        phrases.push_back(phrase);
+    }
+
+    return phrases;
+}
+
+/**
+ * Replays every phrase in a query mode, timing each one
+ * @param query: query engine to replay against
+ * @param phrases: phrases to replay
+ * @param slop: slop of phrase queries, -1 to run them as bag-of-words queries instead
+ * @param length: only replay phrases of this many words
+ * @return latency of every phrase replayed, in microseconds, sorted
+*/
+vector<double> replay(const Query& query, const vector<Phrase>& phrases, int slop, int length) {
+    vector<double> latencies;
+
+    for (const Phrase& phrase: phrases) {
+        if (phrase.length != length) {
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        PooledAccumulators scores = slop < 0 ? query.calculate_scores(query.tokenize_input(phrase.text), true)
+                                             : query.calculate_phrase_scores(query.tokenize_phrase(phrase.text), slop, true);
+        query.top_documents(*scores, 10);
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        latencies.push_back(elapsed.count());
+    }
+
+    sort(latencies.begin(), latencies.end());
+
+    return latencies;
+}
+
+/**
+ * Indexes the corpus without and with positions, reporting the time taken and the memory of the positions
+ * @param path: corpus to index
+ * @param threads: number of worker threads
+*/
+void report_size(const string& path, int threads) {
+    cout << "positions     ingest  relevance   postings  postings(MB)  positions(MB)  overhead\n";
+
+    for (bool positions: {false, true}) {
+        IndexConfig config{threads};
+        config.positions = positions;
+        Index index(path, config);
+
+        start_timer();
+        if (index.ingest_pages() != 0) {
+            cout << "could not load " << path << '\n';
+            exit(1);
+        }
+        double ingest = elapsed_seconds();
+
+        index.batch_links();
+        start_timer();
+        index.batch_relevance();
+        double relevance = elapsed_seconds();
+
+        long postings = index.counter(POSTINGS);
+        double postings_mb = postings * sizeof(pair<int, double>) / 1e6; // one (doc, relevance) per posting
+        double positions_mb = index.counter(POSITION_BYTES) / 1e6;
+        cout << setw(9) << (positions ? "on" : "off") << setw(11) << ingest << setw(11) << relevance << setw(11) << postings
+             << setw(14) << postings_mb << setw(15) << positions_mb << setw(9) << 100 * positions_mb / postings_mb << "%\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    CorpusOptions options;
+    string corpus_path = "";
+    int num_phrases = 2000;
+    int slop = 2;
+    int threads = max(1u, thread::hardware_concurrency());
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i];
+        const char* value = argv[i + 1];
+
+        if (flag == "--corpus") corpus_path = value;
+        else if (flag == "--pages") options.pages = atoi(value);
+        else if (flag == "--phrases") num_phrases = atoi(value);
+        else if (flag == "--slop") slop = max(0, atoi(value));
+        else if (flag == "--threads") threads = atoi(value);
+        else {
+            cout << "unknown flag " << flag << '\n';
+            return 1;
+        }
+    }
+
+    if (corpus_path.empty()) {
+        corpus_path = "/tmp/phrase_bench.xml";
+        generate_corpus(options, corpus_path);
+    }
+
+    vector<Phrase> phrases = sample_phrases(corpus_path, num_phrases);
+
+    if (phrases.empty()) {
+        cout << "no phrases in " << corpus_path << '\n';
+        return 1;
+    }
+
+    cout << fixed << setprecision(3);
+    report_size(corpus_path, threads);
+
+    IndexConfig config{threads};
+    config.positions = true;
+    Query query(corpus_path, config);
+    cout << "\n" << phrases.size() << " phrases, latencies in microseconds\n";
+    cout << "  words             mode   queries       p50       p99\n";
+    cout << setprecision(1);
+
+    vector<int> modes = {-1, 0}; // bag of words, exact phrase
+    if (slop > 0) {
+        modes.push_back(slop);
+    }
+
+    for (int length: {2, 3}) {
+        for (int mode: modes) {
+            vector<double> latencies = replay(query, phrases, mode, length);
+            string label = mode < 0 ? "bag of words" : mode == 0 ? "phrase" : "phrase~" + std::to_string(mode);
+            cout << setw(7) << length << setw(17) << label << setw(10) << latencies.size()
+                 << setw(10) << percentile(latencies, 50) << setw(10) << percentile(latencies, 99) << '\n';
+        }
+    }
+}
@@ -0,0 +1,201 @@
+#include "query.hpp"
+#include "bench/corpus_generator.hpp"
+#include <fstream>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+using std::ifstream;
+using std::atomic;
+using std::setw;
+using std::fixed;
+using std::setprecision;
+
+// Query latency benchmark: indexes a corpus, then replays a query log at a given concurrency,
+// reporting QPS and latency percentiles for single- and multi-term queries, with and without
+// PageRank. Latency covers tokenizing, scoring and picking the top 10 of a query.
+//
+// usage: bench/query_bench [--corpus PATH | --pages N] [--queries PATH | --num-queries N]
+//                          [--concurrency N] [--repeat N] [--pagerank on|off|both] [--threads N]
+
+// latency of one replayed query
+struct Sample {
+    bool multi_term; // more than one token in the query
+    double micros; // latency in microseconds
+};
+
+/**
+ * Finds a percentile of sorted latencies
+ * @param sorted: latencies, sorted ascending
+ * @param p: percentile, in [0, 100]
+ * @return latency at that percentile
+*/
+double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    size_t i = (size_t) (p / 100 * (sorted.size() - 1) + 0.5);
+
+    return sorted[min(i, sorted.size() - 1)];
+}
+
+/**
+ * Prints QPS and latency percentiles of some samples
+ * @param label: name of the row
+ * @param latencies: latencies of the samples, in microseconds
+ * @param seconds: wall time of the whole replay
+*/
+void report(const string& label, vector<double> latencies, double seconds) {
+    sort(latencies.begin(), latencies.end());
+    cout << setw(22) << label << setw(9) << latencies.size() << setw(11) << latencies.size() / seconds
+         << setw(10) << percentile(latencies, 50) << setw(10) << percentile(latencies, 95)
+         << setw(10) << percentile(latencies, 99) << setw(10) << percentile(latencies, 99.9) << '\n';
+}
+
+/**
+ * Prints a histogram of latencies with power of two buckets
+ * @param latencies: latencies, in microseconds
+*/
+void histogram(const vector<double>& latencies) {
+    vector<long> buckets(40, 0); // [2^i, 2^(i+1)) microseconds
+    long most = 1;
+    int last = 0;
+
+    for (double micros: latencies) {
+        int i = micros < 1 ? 0 : min(39, (int) std::log2(micros));
+        most = max(most, ++buckets[i]);
+        last = max(last, i);
+    }
+
+    for (int i = 0; i <= last; i++) {
+        cout << setw(10) << (1L << i) << "us " << setw(9) << buckets[i] << ' ' << string(buckets[i] * 50 / most, '#') << '\n';
+    }
+}
+
+/**
+ * Replays every query of the log on a number of threads
+ * @param query: query engine to replay against
+ * @param queries: query log
+ * @param concurrency: number of threads replaying queries
+ * @param repeat: times the log is replayed
+ * @param use_page_rank: whether to include pagerank or not in scoring
+ * @param seconds: set to the wall time of the replay
+ * @return latency of every query replayed
+*/
+vector<Sample> replay(const Query& query, const vector<string>& queries, int concurrency, int repeat, bool use_page_rank, double& seconds) {
+    long total = (long) queries.size() * repeat;
+    vector<vector<Sample>> thread_samples(concurrency);
+    vector<thread> threads;
+    atomic<long> next(0);
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < concurrency; i++) {
+        threads.emplace_back([&, i]() {
+            for (long q = next++; q < total; q = next++) {
+                auto query_start = std::chrono::steady_clock::now();
+                vector<string> tokens = query.tokenize_input(queries[q % queries.size()]);
+                vector<pair<int, double>> results = query.top_documents(*query.calculate_scores(tokens, use_page_rank), 10);
+                std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - query_start;
+                thread_samples[i].push_back({tokens.size() > 1, elapsed.count()});
+            }
+        });
+    }
+
+    for (auto& t: threads) {
+        t.join();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    seconds = elapsed.count();
+    vector<Sample> samples;
+
+    for (const auto& s: thread_samples) {
+        samples.insert(samples.end(), s.begin(), s.end());
+    }
+
+    return samples;
+}
+
+int main(int argc, char** argv) {
+    CorpusOptions options;
+    string corpus_path = "";
+    string queries_path = "";
+    int num_queries = 10000;
+    int concurrency = max(1u, thread::hardware_concurrency());
+    int repeat = 1;
+    int threads = max(1u, thread::hardware_concurrency());
+    string page_rank = "both";
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i];
+        const char* value = argv[i + 1];
+
+        if (flag == "--corpus") corpus_path = value;
+        else if (flag == "--pages") options.pages = atoi(value);
+        else if (flag == "--queries") queries_path = value;
+        else if (flag == "--num-queries") num_queries = atoi(value);
+        else if (flag == "--concurrency") concurrency = max(1, atoi(value));
+        else if (flag == "--repeat") repeat = max(1, atoi(value));
+        else if (flag == "--pagerank") page_rank = value;
+        else if (flag == "--threads") threads = atoi(value);
+        else {
+            cout << "unknown flag " << flag << '\n';
+            return 1;
+        }
+    }
+
+    if (corpus_path.empty()) {
+        corpus_path = "/tmp/query_bench.xml";
+        generate_corpus(options, corpus_path);
+    }
+
+    if (queries_path.empty()) {
+        queries_path = "/tmp/query_bench_queries.txt";
+        generate_queries(options, num_queries, queries_path);
+    }
+
+    vector<string> queries;
+    ifstream file(queries_path);
+    string line;
+
+    while (getline(file, line)) {
+        if (!line.empty()) {
+            queries.push_back(line);
+        }
+    }
+
+    if (queries.empty()) {
+        cout << "no queries in " << queries_path << '\n';
+        return 1;
+    }
+
+    start_timer();
+    Query query(corpus_path, IndexConfig{threads});
+    cout << "indexed " << corpus_path << " in " << elapsed_seconds() << "s, replaying " << queries.size()
+         << " queries x" << repeat << " on " << concurrency << " threads\n";
+    cout << fixed << setprecision(1);
+
+    for (bool use_page_rank: {true, false}) {
+        if ((use_page_rank && page_rank == "off") || (!use_page_rank && page_rank == "on")) {
+            continue;
+        }
+
+        double seconds = 0;
+        vector<Sample> samples = replay(query, queries, concurrency, repeat, use_page_rank, seconds);
+        vector<double> all;
+        vector<double> single;
+        vector<double> multi;
+
+        for (const Sample& sample: samples) {
+            all.push_back(sample.micros);
+            (sample.multi_term ? multi : single).push_back(sample.micros);
+        }
+
+        cout << "\npagerank " << (use_page_rank ? "on" : "off") << ", latencies in microseconds\n";
+        cout << "                 query  queries        qps       p50       p95       p99      p999\n";
+        report("all", all, seconds);
+        report("single-term", single, seconds);
+        report("multi-term", multi, seconds);
+        histogram(all);
+    }
+}
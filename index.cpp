@@ -1,277 +1,1052 @@
 #include "index.hpp"
 #include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
 
 /**
- * Processes every page in xml and populates indexer data structures
+ * Reads the indexing configuration from the environment, INDEX_THREADS, INDEX_PARSERS, INDEX_SHARDS,
+ * INDEX_QUEUE_CAPACITY and INDEX_POSITIONS
+ * @return configuration, defaults for anything unset
 */
-int Index::process_xml() {
-    xml_document doc;
+IndexConfig IndexConfig::from_env() {
+    IndexConfig config;
+    const char* threads = getenv("INDEX_THREADS");
+    const char* parsers = getenv("INDEX_PARSERS");
+    const char* shards = getenv("INDEX_SHARDS");
+    const char* capacity = getenv("INDEX_QUEUE_CAPACITY");
+    const char* positions = getenv("INDEX_POSITIONS");
+    const char* scoring = getenv("INDEX_SCORING");
+    const char* expansions = getenv("INDEX_MAX_EXPANSIONS");
+    const char* fuzzy = getenv("INDEX_FUZZY");
+    const char* impact_bits = getenv("INDEX_IMPACT_BITS");
+    const char* global_scale = getenv("INDEX_GLOBAL_SCALE");
+    const char* impact_order = getenv("INDEX_IMPACT_ORDER");
+    const char* budget = getenv("INDEX_POSTINGS_BUDGET");
+    const char* cache_entries = getenv("INDEX_CACHE_ENTRIES");
+    const char* cache_mb = getenv("INDEX_CACHE_MB");
 
-    if (!doc.load_file(xml_filepath)) {
-        return -1; // failure
+    if (threads) {
+        config.threads = atoi(threads);
+    }
+
+    if (parsers) {
+        config.parsers = atoi(parsers);
+    }
+
+    if (shards) {
+        config.shards = atoi(shards);
+    }
+
+    if (capacity) {
+        config.queue_capacity = atoi(capacity);
+    }
+
+    if (positions) {
+        config.positions = atoi(positions) != 0;
+    }
+
+    if (scoring) {
+        parse_scoring(scoring, config.scoring); // unknown names leave the default
+    }
+
+    if (impact_bits && (atoi(impact_bits) == 8 || atoi(impact_bits) == 16)) {
+        config.impact_bits = atoi(impact_bits); // other widths leave scores exact
+    }
+
+    if (global_scale) {
+        config.global_scale = atoi(global_scale) != 0;
+    }
+
+    if (impact_order) {
+        config.impact_order = atoi(impact_order) != 0;
+    }
+
+    if (budget) {
+        config.postings_budget = atol(budget);
+    }
+
+    if (expansions) {
+        config.max_expansions = atoi(expansions);
     }
 
-    xpath_node_set nodes = doc.select_nodes("/xml/page");; // FIX THIS
+    if (fuzzy) {
+        config.fuzzy = atoi(fuzzy);
+    }
+
+    if (cache_entries) {
+        config.cache_entries = atol(cache_entries);
+    }
+
+    if (cache_mb) {
+        config.cache_mb = atol(cache_mb);
+    }
+
+    return config;
+}
+
+/**
+ * Reads --threads, --parsers, --shards, --queue-capacity, --positions (0 or 1), --scoring (tfidf, bm25 or bm25f),
+ * --impact-bits (0, 8 or 16), --global-scale (0 or 1), --impact-order (0 or 1), --postings-budget, --max-expansions,
+ * --fuzzy (0 to 2), --cache-entries and --cache-mb from command line arguments, overriding the current values
+ * @param argc: number of arguments
+ * @param argv: arguments, argv[0] is skipped
+ * @return 0 on success, -1 on an unknown flag, a flag without a value, an unknown scoring function or impact width
+*/
+int IndexConfig::parse_args(int argc, char** argv) {
+    for (int i = 1; i < argc; i += 2) {
+        string flag = argv[i];
+
+        if (i + 1 == argc) {
+            return -1; // missing value
+        }
+
+        if (flag == "--threads") threads = atoi(argv[i + 1]);
+        else if (flag == "--parsers") parsers = atoi(argv[i + 1]);
+        else if (flag == "--shards") shards = atoi(argv[i + 1]);
+        else if (flag == "--queue-capacity") queue_capacity = atoi(argv[i + 1]);
+        else if (flag == "--positions") positions = atoi(argv[i + 1]) != 0;
+        else if (flag == "--scoring") {
+            if (!parse_scoring(argv[i + 1], scoring)) {
+                return -1;
+            }
+        }
+        else if (flag == "--impact-bits") {
+            impact_bits = atoi(argv[i + 1]);
+
+            if (impact_bits != 0 && impact_bits != 8 && impact_bits != 16) {
+                return -1;
+            }
+        }
+        else if (flag == "--global-scale") global_scale = atoi(argv[i + 1]) != 0;
+        else if (flag == "--impact-order") impact_order = atoi(argv[i + 1]) != 0;
+        else if (flag == "--postings-budget") postings_budget = atol(argv[i + 1]);
+        else if (flag == "--max-expansions") max_expansions = atoi(argv[i + 1]);
+        else if (flag == "--fuzzy") fuzzy = atoi(argv[i + 1]);
+        else if (flag == "--cache-entries") cache_entries = atol(argv[i + 1]);
+        else if (flag == "--cache-mb") cache_mb = atol(argv[i + 1]);
+        else return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Number of worker threads to use
+ * @return threads, or the number of cores if unset
+*/
+int IndexConfig::thread_count() const {
+    int count = threads > 0 ? threads : thread::hardware_concurrency();
+
+    return max(1, count);
+}
+
+/**
+ * Number of threads parsing xml, when the corpus can be split into ranges of pages, or decompressing
+ * it, when it is a multistream bzip2 file, which takes at least 2 to be done in parallel and leaves a
+ * thread for processing besides the parser and the accumulator from 5 worker threads on
+ * @return parsers, or one per 4 worker threads if unset, but at least 2 from 5 worker threads on
+*/
+int IndexConfig::parser_count() const {
+    int count = thread_count();
+
+    return parsers > 0 ? parsers : count < 5 ? 1 : max(2, count / 4);
+}
+
+/**
+ * Number of word partitions and term buckets to use
+ * @return shards, or 16 per worker thread if unset
+*/
+int IndexConfig::shard_count() const {
+    return shards > 0 ? shards : thread_count() * 16;
+}
+
+/**
+ * Number of pages each queue between ingest stages holds
+ * @return queue_capacity, or 64 per worker thread if unset
+*/
+int IndexConfig::page_queue_capacity() const {
+    return queue_capacity > 0 ? queue_capacity : thread_count() * 64;
+}
+
+/**
+ * Number of terms a prefix query expands to at most
+ * @return max_expansions, or 64 if unset
+*/
+int IndexConfig::expansion_limit() const {
+    return max_expansions > 0 ? max_expansions : 64;
+}
+
+/**
+ * Bits of a quantized posting score
+ * @return impact_bits, or 8 if postings are impact ordered without a width, which needs impacts
+*/
+int IndexConfig::impact_width() const {
+    return impact_order && impact_bits == 0 ? 8 : impact_bits;
+}
+
+/**
+ * Constructor for Index, starts the worker threads
+ * @param filepath: path of the xml corpus to index
+ * @param config: worker, shard and queue sizes for every parallel phase, whether to keep positions and how to score postings
+*/
+Index::Index(const string& filepath, const IndexConfig& config) :
+    xml_filepath(filepath), postings(config.impact_width(), config.global_scale),
+    impact_ordered(config.impact_order),
+    positional(config.positions), scorer(make_scorer(config.scoring)),
+    num_threads(config.thread_count()), num_parsers(config.parser_count()),
+    queue_capacity(config.page_queue_capacity()),
+    num_shards(config.shard_count()), pool(max(3, num_threads)) {
+    const char* path = getenv("INDEX_METRICS"); // where to write the json report, if anywhere
 
-    for (xpath_node node: nodes) {
-        all_pages.push_back(node.node());
+    if (path) {
+        metrics_path = path;
+    }
+}
+
+/**
+ * Processes every page in xml and populates indexer data structures, then writes the
+ * metrics report if INDEX_METRICS is set
+ * @return 0 on success, -1 if the xml could not be loaded
+*/
+int Index::process_xml() {
+    if (ingest_pages() != 0) {
+        return -1; // failure
     }
 
-    batch_pages();
+    batch_links();
     batch_relevance();
     batch_weights();
     calculate_page_ranks();
 
+    if (!metrics_path.empty()) {
+        std::ofstream(metrics_path) << metrics_json();
+    }
+
     return 0; // success!
 }
 
 /**
- * Partitions all pages into batches for multi-threaded computation of text processing
+ * Reports the contention of some locks during a phase, in the metrics and on stderr (only in
+ * LOCK_PROFILING builds, a no-op otherwise)
+ * @param phase: name of the phase that just ended
+ * @param mutexes: name of the locks
+ * @param slots: contention of each of them during the phase
 */
-void Index::batch_pages() {
-    int batch_size = all_pages.size() / 10;
-    thread doc_threads[10];
+void Index::report_locks(const char* phase, const char* mutexes, const vector<LockStats>& slots) {
+#ifdef LOCK_PROFILING
+    metrics.record_locks(phase, mutexes, slots);
+    std::cerr << "lock profile after " << phase << " (" << mutexes << "):\n  slot  acquisitions  contended  wait(ms)\n";
 
-    for (int i = 0; i < 10; i++) {
-        doc_threads[i] = thread(&Index::process_pages, this, i, batch_size);
+    for (size_t i = 0; i < slots.size(); i++) {
+        std::cerr << std::setw(6) << i << std::setw(14) << slots[i].acquisitions << std::setw(11) << slots[i].contended
+                  << std::setw(10) << slots[i].wait_nanos / 1e6 << '\n';
     }
+#else
+    (void) phase;
+    (void) mutexes;
+    (void) slots;
+#endif
+}
 
-    for (int i = 0; i < 10; i++) {
-        doc_threads[i].join();
+/**
+ * Produces the metrics report of the indexing run so far
+ * @return report as json
+*/
+string Index::metrics_json() {
+    return metrics.to_json(xml_filepath, num_threads);
+}
+
+/**
+ * Reads, parses and processes every page of the corpus as a pipeline: parsers parse pages out of the
+ * xml, processors tokenize and stem them, and one accumulator accumulates the results, all at once.
+ * Every stage is a task of the pool, and the stages share the worker threads between them: the
+ * parsers, or the one parser and the threads decompressing the corpus when it is streamed, get their
+ * share, the accumulator one thread, and the processors the rest. The stages are connected by bounded
+ * queues, so a stage that runs ahead waits for the next one and at most two queues of pages are in flight
+ * @return 0 on success, -1 if the xml could not be opened or decompressed
+*/
+int Index::ingest_pages() {
+    ScopedTimer timer(metrics, "ingest_pages");
+    MappedFile corpus(xml_filepath);
+    bool split = corpus.is_open() && detect_format(corpus.view().substr(0, 10)) == PLAIN; // uncompressed files are split into ranges and parsed in parallel
+    unique_ptr<PageReader> reader; // anything else is streamed (and decompressed) through one parser
+    int decompressors = 0; // threads the streamed corpus is decompressed on, besides the parser's
+
+    if (!split) {
+        // the parser, the accumulator and at least one processor need a thread each
+        reader.reset(new PageReader(xml_filepath, max(1, min(num_parsers, num_threads - 3))));
+
+        if (!reader->is_open()) {
+            return -1; // failure
+        }
+
+        decompressors = reader->decompression_threads();
+    }
+
+    vector<PageRange> ranges = split ? split_corpus(corpus.view()) : vector<PageRange>();
+    int parsers = split ? max(1, min({num_parsers, (int) ranges.size(), num_threads - 2})) : 1;
+    int processors = max(1, num_threads - parsers - decompressors - 1);
+    atomic<int> next_range{0};
+    atomic<int> running_parsers{parsers};
+    atomic<int> running_processors{processors};
+    BoundedQueue<RawPage> pages(queue_capacity);
+    BoundedQueue<ProcessedPage> processed(queue_capacity);
+    worker_doc_counts.assign(processors, vector<unordered_map<string, int>>(num_shards));
+    words_to_doc_counts.resize(num_shards);
+
+    // parsers first, then the accumulator, then the processors: every task needs a worker of its own,
+    // as they wait on each other, and the pool has at least as many workers as there are tasks
+    pool.run(parsers + 1 + processors, [&](int i) {
+        if (i < parsers) {
+            ScopedTimer parse_timer(metrics, "ingest_pages.parse", i);
+
+            if (split) {
+                parse_ranges(corpus.view(), ranges, next_range, pages);
+            }
+            else {
+                parse_pages(*reader, pages);
+            }
+
+            if (--running_parsers == 0) {
+                pages.close(); // last parser out
+            }
+        }
+        else if (i == parsers) {
+            accumulate_pages(processed);
+        }
+        else {
+            process_pages(i - parsers - 1, pages, processed);
+
+            if (--running_processors == 0) {
+                processed.close(); // last processor out
+            }
+        }
+    });
+
+    if (reader && reader->failed()) {
+        return -1; // corrupt or truncated corpus, some pages are missing
+    }
+
+    metrics.add(QUEUE_FULL_WAITS, pages.full_wait_count() + processed.full_wait_count());
+    metrics.add(QUEUE_EMPTY_WAITS, pages.empty_wait_count() + processed.empty_wait_count());
+    report_locks("ingest_pages", "page_queues", {pages.wait_stats(), processed.wait_stats()});
+
+    // reduce the doc counts of every worker, one task per word partition
+    {
+        ScopedTimer merge_timer(metrics, "ingest_pages.merge_doc_counts");
+        pool.run(num_shards, [&](int i) { merge_doc_counts(i); });
+    }
+
+    worker_doc_counts.clear();
+    report_locks("ingest_pages", "thread_pool", {pool.take_lock_stats()});
+
+    // every title is known now, first title wins if the corpus has duplicates
+    for (int doc = 0; doc < (int) doc_titles.size(); doc++) {
+        titles_to_doc_ids.emplace(doc_titles[doc], doc);
     }
+
+    return 0; // success!
 }
 
 /**
- * Processes the text for one batch of pages
- * @param batch_num: n-th batch
- * @param batch_size: size of batch
+ * Splits a mapped corpus into ranges of pages for the parsers, and numbers the pages by counting
+ * the pages of every range in parallel, so every range knows its first dense doc id
+ * @param corpus: xml of the whole corpus
+ * @return ranges in order, 4 per parser so parsers that finish early can take more
 */
-void Index::process_pages(int batch_num, int batch_size) {
-    int start_index = batch_num * batch_size;
+vector<PageRange> Index::split_corpus(string_view corpus) {
+    ScopedTimer timer(metrics, "ingest_pages.split");
+    vector<PageRange> ranges = PageReader::split_pages(corpus, num_parsers * 4);
+    vector<int> counts(ranges.size());
 
-    // if on last batch, need to overcompensate since batches are too small
-    if (batch_num + 1 == 10) {
-        batch_size += all_pages.size() % 10;
-    } 
+    pool.run(ranges.size(), [&](int i) {
+        counts[i] = PageReader::count_pages(corpus.substr(ranges[i].begin, ranges[i].end - ranges[i].begin));
+    });
+
+    for (size_t i = 1; i < ranges.size(); i++) {
+        ranges[i].first_doc = ranges[i - 1].first_doc + counts[i - 1];
+    }
+
+    return ranges;
+}
+
+/**
+ * Parsing stage for a streamed corpus: parses every page in order and hands it to the processing stage
+ * @param reader: reader of the corpus
+ * @param pages: queue to the processing stage
+*/
+void Index::parse_pages(PageReader& reader, BoundedQueue<RawPage>& pages) {
+    xml_document page_xml; // reused for every page
+    string_view page_text;
+    int doc = 0;
 
-    for (int i = start_index; i < start_index + batch_size; i++) {
-        xml_node page = all_pages[i];
-        int id = stoi(trim(page.child("id").text().get()));
-        string title = lower(trim(page.child("title").text().get()));
-        string text  = lower(trim(page.child("text").text().get()));
-        int d_id = id % 10; // lock d_id-th mutex!
-        titles_to_ids[d_id][title] = id;
-        doc_mutexes[d_id].lock();
-        titles_to_processed_text[d_id][title] = process_text(title, text, d_id);
-        doc_mutexes[d_id].unlock();
+    while (reader.next(page_text)) {
+        parse_page(page_xml, page_text, doc++, pages);
     }
 }
 
 /**
- * Processes the text for a single document
+ * Parsing stage for a mapped corpus: takes ranges of pages until there are none left, parses every
+ * page of them and hands it to the processing stage
+ * @param corpus: xml of the whole corpus
+ * @param ranges: ranges of pages, shared by every parser
+ * @param next_range: first range nobody has taken yet
+ * @param pages: queue to the processing stage
+*/
+void Index::parse_ranges(string_view corpus, const vector<PageRange>& ranges, atomic<int>& next_range, BoundedQueue<RawPage>& pages) {
+    xml_document page_xml; // reused for every page
+
+    for (int i = next_range++; i < (int) ranges.size(); i = next_range++) {
+        string_view range = corpus.substr(ranges[i].begin, ranges[i].end - ranges[i].begin);
+        size_t from = 0;
+        string_view page_text;
+        int doc = ranges[i].first_doc;
+
+        while (PageReader::find_page(range, from, page_text)) {
+            parse_page(page_xml, page_text, doc++, pages);
+        }
+    }
+}
+
+/**
+ * Parses the xml of a single page and hands its title and text to the processing stage
+ * @param page_xml: document to parse into
+ * @param page_text: xml of the page, from "<page" to "</page>"
+ * @param doc: dense doc id of the page
+ * @param pages: queue to the processing stage
+*/
+void Index::parse_page(xml_document& page_xml, string_view page_text, int doc, BoundedQueue<RawPage>& pages) {
+    if (!page_xml.load_buffer(page_text.data(), page_text.size())) {
+        pages.push({doc, "", ""}); // malformed page, indexed as empty so doc ids stay in corpus order
+        return;
+    }
+
+    xml_node page = page_xml.child("page");
+    pages.push({doc, page.child("title").text().get(), page.child("text").text().get()});
+}
+
+/**
+ * Processing stage: tokenizes and stems pages until the parsing stage is done
+ * @param worker: n-th worker
+ * @param pages: queue from the parsing stage
+ * @param processed: queue to the accumulating stage
+*/
+void Index::process_pages(int worker, BoundedQueue<RawPage>& pages, BoundedQueue<ProcessedPage>& processed) {
+    ScopedTimer timer(metrics, "ingest_pages", worker);
+    PageScratch scratch; // reused for every page this worker processes!
+    scratch.worker = worker;
+    RawPage page;
+
+    while (pages.pop(page)) {
+        ProcessedPage result;
+        result.doc = page.doc;
+        result.title = lower(trim(page.title));
+        lower_in_place(page.text);
+        result.term_counts = process_text(result.title, trim(page.text), scratch);
+        result.positions = scratch.positions;
+        result.links = move(scratch.page_links);
+        result.stats.length = scratch.length;
+        result.stats.max_count = scratch.max_count;
+        result.stats.title_length = min(scratch.title_length, 65535);
+        result.title_counts = move(scratch.title_counts);
+        scratch.title_counts.clear();
+        scratch.page_links.clear();
+        scratch.pages++;
+        processed.push(move(result));
+    }
+
+    // counted locally, reported once per worker
+    metrics.add(PAGES, scratch.pages);
+    metrics.add(TOKENS, scratch.tokens);
+    metrics.add(STEMS, scratch.stems);
+    metrics.add(LINKS, scratch.links);
+    metrics.add(ARENA_BLOCKS, scratch.arena.block_count());
+    metrics.add(ARENA_BYTES, scratch.arena.capacity());
+}
+
+/**
+ * Accumulating stage: files every processed page under its doc id until the processing stage is done
+ * @param processed: queue from the processing stage
+*/
+void Index::accumulate_pages(BoundedQueue<ProcessedPage>& processed) {
+    ScopedTimer timer(metrics, "ingest_pages.accumulate");
+    ProcessedPage page;
+
+    while (processed.pop(page)) {
+        // pages arrive out of order, grow to fit
+        if (page.doc >= (int) doc_titles.size()) {
+            doc_titles.resize(page.doc + 1);
+            page_links.resize(page.doc + 1);
+            doc_term_counts.resize(page.doc + 1);
+            doc_stats.resize(page.doc + 1);
+            doc_title_counts.resize(scorer->needs_title_counts() ? page.doc + 1 : 0);
+            doc_positions.resize(positional ? page.doc + 1 : 0);
+        }
+
+        doc_titles[page.doc] = move(page.title);
+        page_links[page.doc] = move(page.links);
+        doc_term_counts[page.doc] = move(page.term_counts);
+        doc_stats[page.doc] = page.stats;
+
+        if (scorer->needs_title_counts()) {
+            doc_title_counts[page.doc] = move(page.title_counts);
+        }
+
+        if (positional) {
+            doc_positions[page.doc] = move(page.positions);
+        }
+    }
+}
+
+/**
+ * Processes the text for a single document, keeping all per-token work inside the batch's scratch space
  * @param title: title of doc to process
  * @param text: text of doc to process
- * @param d_id: mutex number to lock
- * @return processed text as dict of words -> counts
+ * @param scratch: scratch space of the worker processing the doc
+ * @return processed text as words and their counts
 */
-unordered_map<string, int> Index::process_text(string title, string text, int d_id) {
-    vector<string> all_tokens = processor.tokenize(title);
-    vector<string> text_tokens = processor.tokenize(text);
-    all_tokens.insert(all_tokens.end(), text_tokens.begin(), text_tokens.end()); // combine to get all tokens!
-    unordered_map<string, int> processed_text;
-    int max_count = 0;
+vector<pair<string, int>> Index::process_text(string_view title, string_view text, PageScratch& scratch) {
+    scratch.arena.reset(); // previous page is done with it
+    scratch.max_count = 0;
+    scratch.length = 0;
+    scratch.position = 0;
+    scratch.occurrences.clear();
+    scratch.positions.clear();
+    TermCounts processed_text(64, hash<string_view>(), equal_to<string_view>(), ArenaAllocator<pair<const string_view, int>>(scratch.arena));
+    process_tokens(title, processed_text, scratch);
+    scratch.title_length = scratch.length;
 
-    while (all_tokens.size() > 0) {
-        string token = all_tokens.back();
-        all_tokens.pop_back();
+    // only the title has been counted so far
+    if (scorer->needs_title_counts()) {
+        for (const auto& x: processed_text) {
+            scratch.title_counts.emplace_back(string(x.first), x.second);
+        }
+    }
 
-        if (processor.is_link(token)) {
-            vector<string> new_tokens = extract_tokens_from_link(token.substr(2, token.size() - 4), title, d_id); 
-            all_tokens.insert(all_tokens.end(), new_tokens.begin(), new_tokens.end()); // add tokens to be processed
+    process_tokens(text, processed_text, scratch);
+
+    // group the occurrences by word, keeping each word's positions in order
+    if (positional) {
+        stable_sort(scratch.occurrences.begin(), scratch.occurrences.end(),
+            [](const pair<const char*, int>& a, const pair<const char*, int>& b) { return a.first < b.first; });
+    }
+
+    // copy out of the arena, which gets reused by the next page
+    vector<pair<string, int>> counts;
+    counts.reserve(processed_text.size());
+
+    for (const auto& x: processed_text) {
+        counts.emplace_back(string(x.first), x.second);
+
+        if (positional) {
+            encode_positions(x.first.data(), scratch);
         }
-        else if (!processor.is_stop_word(token)) {
-            string stemmed_word = processor.stem_word(token);
-            
-            // this should only happen once for a given word in this doc!
-            if (processed_text.count(stemmed_word) == 0) {
-                int w_id = (abs(stemmed_word.front() - 97) % 26) / 2;
-                word_mutexes[w_id].lock();
-                words_to_doc_counts[w_id][stemmed_word] += 1;
-                word_mutexes[w_id].unlock();
-            }
+    }
+
+    return counts;
+}
+
+/**
+ * Appends the position entry of one word of the page being processed
+ * @param key: the word's key in the page's TermCounts, which its occurrences point to
+ * @param scratch: scratch space of the worker processing the doc, with its occurrences grouped by word
+*/
+void Index::encode_positions(const char* key, PageScratch& scratch) {
+    auto first = lower_bound(scratch.occurrences.begin(), scratch.occurrences.end(), key,
+        [](const pair<const char*, int>& occurrence, const char* word) { return occurrence.first < word; });
+    string& entry = scratch.word; // free between words, so its capacity is reused
+    int prev = 0;
+    entry.clear();
+
+    for (auto it = first; it != scratch.occurrences.end() && it->first == key; it++) {
+        put_varint(entry, it->second - prev);
+        prev = it->second;
+    }
 
-            processed_text[stemmed_word] += 1;
-            max_count = max(max_count, processed_text[stemmed_word]);
+    put_varint(scratch.positions, entry.size());
+    scratch.positions += entry;
+}
+
+/**
+ * Processes every token of a text, following links
+ * @param text: text to tokenize
+ * @param processed_text: counts of the words processed so far
+ * @param scratch: scratch space of the worker processing the doc
+*/
+void Index::process_tokens(string_view text, TermCounts& processed_text, PageScratch& scratch) {
+    string_view token;
+    size_t pos = 0;
+
+    while (processor.next_token(text, pos, token)) {
+        scratch.tokens++;
+
+        if (processor.is_link(token)) {
+            extract_tokens_from_link(token.substr(2, token.size() - 4), processed_text, scratch);
+        }
+        else {
+            process_word(token, processed_text, scratch);
         }
     }
+}
+
+/**
+ * Stems a single token and counts it, unless it is a stop word
+ * @param token: token to process
+ * @param processed_text: counts of the words processed so far
+ * @param scratch: scratch space of the worker processing the doc
+*/
+void Index::process_word(string_view token, TermCounts& processed_text, PageScratch& scratch) {
+    string& word = scratch.word;
+    word.assign(token.data(), token.size()); // no allocation once its capacity has grown!
+    int position = scratch.position++; // stop words take up a position too, so phrases with them still line up
+
+    if (processor.is_stop_word(word)) {
+        return;
+    }
+
+    processor.stem_word(word);
+    scratch.stems++;
+    scratch.length++;
+    auto it = processed_text.find(word);
+
+    // this should only happen once for a given word in this doc!
+    if (it == processed_text.end()) {
+        worker_doc_counts[scratch.worker][word_partition(word)][word] += 1;
+        it = processed_text.emplace(scratch.arena.copy(word), 0).first;
+    }
+
+    it->second += 1;
+    scratch.max_count = max(scratch.max_count, it->second);
+
+    if (positional) {
+        scratch.occurrences.emplace_back(it->first.data(), position);
+    }
+}
+
+/**
+ * Finds the partition of a given word, for reducing doc counts in parallel
+ * @param word: word to hash
+ * @return partition of the word, in [0, num_shards)
+*/
+int Index::word_partition(const string& word) {
+    return hash<string>()(word) % num_shards;
+}
 
-    titles_to_max_counts[d_id][title] = max_count;
+/**
+ * Sums the doc counts of every worker for one partition of words
+ * @param partition: partition of words owned by this task
+*/
+void Index::merge_doc_counts(int partition) {
+    ScopedTimer timer(metrics, "ingest_pages.merge_doc_counts", partition);
+    unordered_map<string, int>& doc_counts = words_to_doc_counts[partition];
 
-    return processed_text;
+    for (auto& counts: worker_doc_counts) {
+        if (doc_counts.empty()) {
+            doc_counts.swap(counts[partition]); // nothing to add to yet!
+            continue;
+        }
+
+        for (const auto& x: counts[partition]) {
+            doc_counts[x.first] += x.second;
+        }
+
+        unordered_map<string, int>().swap(counts[partition]);
+    }
 }
 
 /**
- * Produces vector of tokens from a given link and updates graph of page linking relationships
+ * Processes the tokens of a given link and records the raw link target for resolve_links
  * @param link: the link to be tokenized
- * @param title: the title of the document containing the link
- * @param d_id: mutex number to lock
- * @return vector of tokens produced from the link
- * (need to be careful about this method for find)
+ * @param processed_text: counts of the words processed so far
+ * @param scratch: scratch space of the worker processing the doc containing the link
 */
-vector<string> Index::extract_tokens_from_link(string link, string title, int d_id) {
-    if (link.find('|') != string::npos) {
-        string left = split_string(link, '|')[0]; // links to this title, non-tokenized
-        vector<string> right = processor.tokenize(split_string(link, '|')[1]); // only want text right of the "|" as tokens
-        page_weights[d_id][title][left] = 1; // placeholder
+void Index::extract_tokens_from_link(string_view link, TermCounts& processed_text, PageScratch& scratch) {
+    size_t bar = link.find('|');
+    scratch.links++;
 
-        return right;
+    if (bar != string::npos) {
+        string_view right = link.substr(bar + 1);
+        scratch.page_links.emplace_back(link.substr(0, bar)); // links to this title, non-tokenized
+        process_tokens(right.substr(0, right.find('|')), processed_text, scratch); // only want text right of the "|" as tokens
     }
     else if (link.find("Category:") != string::npos) {
-        vector<string> tokens = processor.tokenize(link.substr(link.find("Category:") + 9));
-        tokens.push_back("category");
-        page_weights[d_id][title][link] = 1; // placeholder
-
-        return tokens;
+        scratch.page_links.emplace_back(link);
+        process_tokens(link.substr(link.find("Category:") + 9), processed_text, scratch);
+        process_word("category", processed_text, scratch);
     }
     else {
-        page_weights[d_id][title][link] = 1; // placeholder
+        scratch.page_links.emplace_back(link);
+        process_tokens(link, processed_text, scratch);
+    }
+}
+
+/**
+ * Partitions all pages into batches for multi-threaded resolution of link targets,
+ * once every title in the corpus is known
+*/
+void Index::batch_links() {
+    ScopedTimer timer(metrics, "batch_links");
+    int batch_size = doc_titles.size() / num_threads;
+    out_links.resize(doc_titles.size());
+
+    pool.run(num_threads, [&](int i) { resolve_links(i, batch_size); });
+    report_locks("batch_links", "thread_pool", {pool.take_lock_stats()});
+}
+
+/**
+ * Maps the raw link targets of one batch of pages to dense doc ids, dropping
+ * dangling links, self links and duplicates
+ * @param batch_num: n-th batch
+ * @param batch_size: size of batch
+*/
+void Index::resolve_links(int batch_num, int batch_size) {
+    ScopedTimer timer(metrics, "batch_links", batch_num);
+    int start_index = batch_num * batch_size;
+    long resolved = 0;
 
-        return processor.tokenize(link);
+    // if on last batch, need to overcompensate since batches are too small
+    if (batch_num + 1 == num_threads) {
+        batch_size += doc_titles.size() % num_threads;
     }
+
+    for (int doc = start_index; doc < start_index + batch_size; doc++) {
+        vector<int>& targets = out_links[doc];
+
+        for (const string& link: page_links[doc]) {
+            auto it = titles_to_doc_ids.find(link);
+
+            if (it != titles_to_doc_ids.end() && doc_titles[it->second] != doc_titles[doc]) {
+                targets.push_back(it->second);
+            }
+        }
+
+        sort(targets.begin(), targets.end());
+        targets.erase(unique(targets.begin(), targets.end()), targets.end());
+        resolved += targets.size();
+        vector<string>().swap(page_links[doc]); // raw targets are no longer needed!
+    }
+
+    metrics.add(RESOLVED_LINKS, resolved);
 }
 
 /**
- * Partitions all words into batches for multi-threaded computation
+ * Computes all term relevances in two passes: every batch of documents emits its relevances into
+ * its own buffers, which are then merged per term bucket by the thread that owns the bucket, and
+ * finally packed into the flat postings, exact or quantized
 */
 void Index::batch_relevance() {
+    ScopedTimer timer(metrics, "batch_relevance");
     double n = calculate_n();
-    thread word_threads[26];
+    int batch_size = doc_term_counts.size() / num_threads;
+    CollectionStats corpus{n, 0, 0};
 
-    for (int i = 0; i < 26; i++) {
-        word_threads[i] = thread(&Index::calculate_relevance, this, i, n); // i is w_id!
+    for (const DocStats& stats: doc_stats) {
+        corpus.avg_length += stats.length / max(n, 1.0);
+        corpus.avg_title_length += stats.title_length / max(n, 1.0);
     }
 
-    for (int i = 0; i < 26; i++) {
-        word_threads[i].join();
+    scorer->prepare(corpus);
+    assign_term_ids();
+    balance_term_buckets();
+    relevance_buffers.assign(num_threads, vector<vector<tuple<int, int, double, int>>>(num_shards));
+
+    pool.run(num_threads, [&](int i) { calculate_relevance(i, batch_size); });
+
+    vector<double> max_relevances(num_threads, 0); // worker threads -> highest relevance they merged
+
+    {
+        ScopedTimer merge_timer(metrics, "batch_relevance.merge_relevance");
+        pool.run(num_threads, [&](int i) { max_relevances[i] = merge_relevance(i); });
+    }
+
+    relevance_buffers.clear();
+    ScopedTimer pack_timer(metrics, "batch_relevance.pack_postings");
+    int terms_batch_size = term_postings.size() / num_threads;
+    postings.allocate(term_postings);
+    postings.set_max_score(*max_element(max_relevances.begin(), max_relevances.end())); // only used by a global scale
+
+    if (impact_ordered) {
+        impact_postings.allocate(postings);
     }
+
+    pool.run(num_threads, [&](int i) { pack_postings(i, terms_batch_size); });
+    vector<vector<pair<int, double>>>().swap(term_postings);
+    metrics.add(POSTINGS_BYTES, postings.memory_bytes());
+
+    if (impact_ordered) {
+        impact_postings.finish();
+        metrics.add(POSTINGS_BYTES, impact_postings.memory_bytes());
+    }
+
+    vector<string>().swap(doc_positions); // every entry has been copied into term_positions
+    vector<vector<pair<string, int>>>().swap(doc_title_counts);
+    report_locks("batch_relevance", "thread_pool", {pool.take_lock_stats()});
 }
 
 /**
- * Calculates the relevance between all terms in the corpus in a given bucket and all documents
- * @param w_id: mutex id for this current bucket of words
- * @param n: number of total documents in the corpus
+ * Gives every word in the corpus a dense term id
 */
-void Index::calculate_relevance(int w_id, double n) {
-    for (const auto& x: words_to_doc_counts[w_id]) {
-        string word = x.first;
-        double idf = log(n / words_to_doc_counts[w_id][word]);
+void Index::assign_term_ids() {
+    // for each word partition
+    for (auto& doc_counts: words_to_doc_counts) {
+        for (const auto& x: doc_counts) {
+            words_to_term_ids[x.first] = term_words.size();
+            term_words.push_back(x.first);
+            term_doc_counts.push_back(x.second);
+        }
+
+        unordered_map<string, int>().swap(doc_counts);
+    }
+
+    term_postings.resize(term_words.size());
+    term_positions.resize(positional ? term_words.size() : 0);
+    metrics.add(TERMS, term_words.size());
+
+    ScopedTimer timer(metrics, "batch_relevance.term_dictionary");
+    dictionary.build(term_words);
+    vector<string>().swap(term_words); // the dictionary has every word, front-coded
+    metrics.add(DICTIONARY_BYTES, dictionary.memory_bytes());
+}
+
+/**
+ * Spreads the term buckets over the worker threads so every thread merges about the same number
+ * of postings (largest bucket first, onto the least loaded thread), and sizes each term's postings
+*/
+void Index::balance_term_buckets() {
+    vector<long> bucket_loads(num_shards, 0);
+    vector<int> buckets(num_shards);
+    priority_queue<pair<long, int>, vector<pair<long, int>>, greater<pair<long, int>>> thread_loads; // (load, thread), least loaded on top
+
+    for (int term_id = 0; term_id < (int) term_doc_counts.size(); term_id++) {
+        int num_postings = term_doc_counts[term_id]; // one posting per doc w/ this term
+        bucket_loads[term_bucket(term_id)] += num_postings;
+        term_postings[term_id].reserve(num_postings);
+    }
 
-        // for each doc id bucket
-        for (int d_id = 0; d_id < 10; d_id++) {
-            for (const auto& y: titles_to_ids[d_id]) {
-                string title = y.first;
+    for (int i = 0; i < num_shards; i++) {
+        buckets[i] = i;
+    }
+
+    sort(buckets.begin(), buckets.end(), [&](int a, int b) { return bucket_loads[a] > bucket_loads[b]; });
+    thread_buckets.assign(num_threads, {});
+
+    for (int i = 0; i < num_threads; i++) {
+        thread_loads.emplace(0, i);
+    }
 
-                if (titles_to_processed_text[d_id][title].count(word) > 0) {
-                    double tf = (double) titles_to_processed_text[d_id][title][word] / titles_to_max_counts[d_id][title];
-                    term_relevances[w_id][word][title] = tf * idf;
+    for (int bucket: buckets) {
+        auto least_loaded = thread_loads.top();
+        thread_loads.pop();
+        thread_buckets[least_loaded.second].push_back(bucket);
+        thread_loads.emplace(least_loaded.first + bucket_loads[bucket], least_loaded.second);
+    }
+}
+
+/**
+ * Copies one batch of terms' postings into the flat postings, quantizing them if impacts are kept,
+ * and sorting them by impact too if impact ordered, and frees them
+ * @param batch_num: n-th batch of term ids
+ * @param batch_size: size of batch
+*/
+void Index::pack_postings(int batch_num, int batch_size) {
+    int start_index = batch_num * batch_size;
+
+    // if on last batch, need to overcompensate since batches are too small
+    if (batch_num + 1 == num_threads) {
+        batch_size += term_postings.size() % num_threads;
+    }
+
+    for (int term_id = start_index; term_id < start_index + batch_size; term_id++) {
+        postings.fill(term_id, term_postings[term_id]);
+
+        if (impact_ordered) {
+            impact_postings.fill(term_id, postings.list(term_id));
+        }
+
+        vector<pair<int, double>>().swap(term_postings[term_id]);
+    }
+}
+
+/**
+ * Finds the term bucket for a given term
+ * @param term_id: term id to hash
+ * @return bucket of the term, in [0, num_shards)
+*/
+int Index::term_bucket(int term_id) {
+    // fibonacci hashing, so neighbouring term ids end up in unrelated buckets
+    unsigned int hash = (unsigned int) term_id * 2654435769u;
+
+    return hash % num_shards;
+}
+
+/**
+ * Calculates the relevance between one batch of documents and every term they contain with the scorer,
+ * visiting each document's word counts exactly once
+ * @param batch_num: n-th batch
+ * @param batch_size: size of batch
+*/
+void Index::calculate_relevance(int batch_num, int batch_size) {
+    ScopedTimer timer(metrics, "batch_relevance", batch_num);
+    int start_index = batch_num * batch_size;
+    auto& buffers = relevance_buffers[batch_num];
+
+    long num_postings = 0;
+    long position_bytes = 0;
+
+    // if on last batch, need to overcompensate since batches are too small
+    if (batch_num + 1 == num_threads) {
+        batch_size += doc_term_counts.size() % num_threads;
+    }
+
+    for (int doc = start_index; doc < start_index + batch_size; doc++) {
+        size_t entry = 0; // offset of the position entry of the current word
+
+        for (const auto& x: doc_term_counts[doc]) {
+            int term_id = words_to_term_ids.at(x.first); // read-only by now!
+            TermInDoc term{x.second, 0, term_doc_counts[term_id]};
+
+            if (scorer->needs_title_counts()) {
+                for (const auto& title_count: doc_title_counts[doc]) {
+                    if (title_count.first == x.first) {
+                        term.title_count = title_count.second; // titles are short, a scan beats a lookup
+                    }
                 }
             }
+
+            buffers[term_bucket(term_id)].emplace_back(term_id, doc, scorer->score(term, doc_stats[doc]), entry);
+
+            if (positional) {
+                size_t length = get_varint(doc_positions[doc].data(), entry);
+                entry += length; // skip to the next word's entry
+            }
         }
+
+        num_postings += doc_term_counts[doc].size();
+        position_bytes += positional ? doc_positions[doc].size() : 0;
     }
+
+    metrics.add(POSTINGS, num_postings);
+    metrics.add(POSITION_BYTES, position_bytes);
 }
 
+/**
+ * Merges the relevances emitted by every batch of documents for the term buckets owned by a thread
+ * (batches are merged in order, so postings stay sorted by doc id)
+ * @param thread_num: n-th worker thread
+ * @return highest relevance merged, 0 if none
+*/
+double Index::merge_relevance(int thread_num) {
+    ScopedTimer timer(metrics, "batch_relevance.merge_relevance", thread_num);
+    double max_relevance = 0;
+    for (int bucket: thread_buckets[thread_num]) {
+        for (auto& buffers: relevance_buffers) {
+            for (const auto& x: buffers[bucket]) {
+                term_postings[get<0>(x)].emplace_back(get<1>(x), get<2>(x));
+                max_relevance = max(max_relevance, get<2>(x));
+
+                if (positional) {
+                    const string& positions = doc_positions[get<1>(x)];
+                    size_t start = get<3>(x);
+                    size_t end = start;
+                    end += get_varint(positions.data(), end);
+                    term_positions[get<0>(x)].append(positions, start, end - start);
+                }
+            }
+
+            vector<tuple<int, int, double, int>>().swap(buffers[bucket]);
+        }
+    }
+
+    return max_relevance;
+}
 
 /**
  * Partitions all pages into batches for multi-threaded computation of weights
 */
 void Index::batch_weights() {
-    double epsilon = 0.15;
-    double n = calculate_n();
-    thread doc_threads[10];
+    ScopedTimer timer(metrics, "batch_weights");
+    double n = doc_titles.size();
+    int batch_size = doc_titles.size() / num_threads;
+    page_weights.resize(doc_titles.size());
 
-    for (int i = 0; i < 10; i++) {
-        doc_threads[i] = thread(&Index::calculate_weights, this, i, n, epsilon); // i is d_id!
-    }
-
-    for (int i = 0; i < 10; i++) {
-        doc_threads[i].join();
-    }
+    pool.run(num_threads, [&](int i) { calculate_weights(i, batch_size, n); });
+    report_locks("batch_weights", "thread_pool", {pool.take_lock_stats()});
 }
 
 /**
- * Calculates and populates page_weights
- * @param d_id: mutex number to lock
+ * Calculates and populates page_weights, the weight a page gives to each page it links to
+ * (pages that link to nothing are treated as linking to every other page)
+ * @param batch_num: n-th batch
+ * @param batch_size: size of batch
  * @param n: number of total documents in the corpus
- * @param epsilon: hyperparameter for weight calculations
 */
-void Index::calculate_weights(int d_id, double n, double epsilon) {
-    for (const auto& x: page_weights[d_id]) {
-        string start_title = x.first;
-        int nk = calculate_nk(start_title, d_id);
-        bool links_to_nothing = false;
+void Index::calculate_weights(int batch_num, int batch_size, double n) {
+    ScopedTimer timer(metrics, "batch_weights", batch_num);
+    int start_index = batch_num * batch_size;
+
+    // if on last batch, need to overcompensate since batches are too small
+    if (batch_num + 1 == num_threads) {
+        batch_size += doc_titles.size() % num_threads;
+    }
+
+    for (int doc = start_index; doc < start_index + batch_size; doc++) {
+        double nk = out_links[doc].size(); // number of (unique) pages that doc links to
 
         if (nk == 0) {
-            links_to_nothing = true;
-            nk = n - 1;
+            nk = n - 1; // links to nothing
         }
 
-        // for each doc bucket (nested)
-        for (int j = 0; j < 10; j++) {
-            for (const auto& y: titles_to_ids[j]) {
-                string end_title = y.first;
-                
-                if (start_title != end_title && (links_to_nothing || page_weights[d_id][start_title][end_title] != 0)) {
-                    page_weights[d_id][start_title][end_title] = (epsilon / n) + ((1 - epsilon) / nk);
-                }
-                else {
-                    page_weights[d_id][start_title][end_title] = epsilon / n;
-                }
-            }
-        }
+        page_weights[doc] = nk > 0 ? (1 - epsilon) / nk : 0;
     }
 }
 
 /**
- * Calculates the page ranks for all documents
+ * Calculates the page ranks for all documents, walking the edge list instead of every pair of pages:
+ * each page gets epsilon / n from every page, plus the weight of each page linking to it
+ * @return number of iterations until the ranks converged
 */
-void Index::calculate_page_ranks() {
-    double n = calculate_n();
+int Index::calculate_page_ranks() {
+    ScopedTimer timer(metrics, "calculate_page_ranks");
+    int n = doc_titles.size();
     double delta = 0.001;
-    unordered_map<string, double> prev;
-    unordered_map<string, double> curr;
-
-    // for each doc bucket!
-    for (int d_id = 0; d_id < 10; d_id++) {
-        for (const auto& x: titles_to_ids[d_id]) {
-            string title = x.first;
-            prev[title] = 0;
-            curr[title] = 1 / n;
-        }
-    }
-    
+    vector<double> prev(n, 0);
+    vector<double> curr(n, 1.0 / n);
+    int iterations = 0;
+
     while (euclidean_distance(prev, curr) > delta) {
-        prev = curr; // creates a copy!
-
-        // for each doc bucket!
-        for (int d_id = 0; d_id < 10; d_id++) {
-            for (const auto& x: titles_to_ids[d_id]) {
-                string end_title = x.first;
-                double total = 0;
-
-                // for each doc bucket (nested)
-                for (int j = 0; j < 10; j++) {
-                    for (const auto& y: titles_to_ids[j]) {
-                        string start_title = y.first;
-                        total += page_weights[j][start_title][end_title] * prev[start_title];
-                    }
-                }
+        prev.swap(curr); // no copy!
+        iterations++;
+        double total = 0;
+        double dangling = 0; // rank spread by pages that link to nothing
 
-                curr[end_title] = total;
+        for (int k = 0; k < n; k++) {
+            total += prev[k];
+
+            if (out_links[k].empty()) {
+                dangling += prev[k] * page_weights[k];
+            }
+        }
+
+        for (int j = 0; j < n; j++) {
+            curr[j] = (epsilon / n) * total + dangling;
+
+            if (out_links[j].empty()) {
+                curr[j] -= prev[j] * page_weights[j]; // pages never link to themselves
+            }
+        }
+
+        for (int k = 0; k < n; k++) {
+            for (int j: out_links[k]) {
+                curr[j] += prev[k] * page_weights[k];
             }
         }
     }
 
-    page_ranks = curr; // we're done! create another copy
+    page_ranks = move(curr); // we're done!
+    metrics.add(PAGE_RANK_ITERATIONS, iterations);
+
+    return iterations;
 }
 
 /**
@@ -279,35 +1054,16 @@ void Index::calculate_page_ranks() {
  * @return n
 */
 int Index::calculate_n() {
-    int n = 0;
-
-    // for each doc bucket
-    for (int i = 0; i < 10; i++) {
-        n += titles_to_ids[i].size();
-    }
-
-    return n;
+    return doc_titles.size();
 }
 
 /**
- * Calculates nk for a given page, where nk the number of (unique) pages that k links to
- * @param start_title: title of document to calculate for
- * @param d_id: mutex number to lock
- * @returns value of nk for the given document
+ * Reads a counter of the indexing run
+ * @param which: counter to read
+ * @return its value so far
 */
-int Index::calculate_nk(string start_title, int d_id) {
-    int nk = 0;
-
-    for (const auto& x: page_weights[d_id][start_title]) {
-        string end_title = x.first;
-        int j = find_d_id(end_title); // inner d_id!
-        
-        if (start_title != end_title && j != -1 && titles_to_ids[j].count(end_title) > 0) {
-            nk += 1;
-        }
-    }
-
-    return nk;
+long Index::counter(Counter which) const {
+    return metrics.get(which);
 }
 
 /**
@@ -316,29 +1072,13 @@ int Index::calculate_nk(string start_title, int d_id) {
  * @param v2: second vector
  * @return euclidean distance between v1 and v2
 */
-double Index::euclidean_distance(unordered_map<string, double> v1, unordered_map<string, double> v2) { 
+double Index::euclidean_distance(const vector<double>& v1, const vector<double>& v2) { 
     double total = 0;
     assert(v1.size() == v2.size());
 
-    for (const auto& x: v1) {
-        string title = x.first;
-        total += pow(v2[title] - v1[title], 2);
+    for (size_t i = 0; i < v1.size(); i++) {
+        total += pow(v2[i] - v1[i], 2);
     }
 
     return sqrt(total);
-}
-
-/**
- * Finds the mutex id corresponding to a given title
- * @param title: title to find id of
- * @return id of the mutex for this title, or -1 if not found
-*/
-int Index::find_d_id(string title) {
-    for (int d_id = 0; d_id < 10; d_id++) {
-        if (titles_to_ids[d_id].count(title) > 0) {
-            return d_id;
-        }
-    }
-
-    return -1; // not found!
 }
\ No newline at end of file
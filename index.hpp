@@ -6,62 +6,214 @@
 #include <shared_mutex>
 #include <assert.h>
 #include <cmath>
+#include <algorithm>
+#include <functional>
+#include <queue>
 #include "pugixml/pugixml.hpp"
 #include "processor/text_processor.hpp"
+#include "util/arena.hpp"
+#include "util/metrics.hpp"
+#include "util/thread_pool.hpp"
+#include "util/bounded_queue.hpp"
+#include "util/page_reader.hpp"
+#include "util/mapped_file.hpp"
+#include "util/varint.hpp"
+#include "util/term_dictionary.hpp"
+#include "util/postings.hpp"
+#include "util/impact_postings.hpp"
+#include "scoring.hpp"
 using std::unordered_map;
 using std::array;
 using std::shared_mutex;
 using std::thread;
 using std::string;
 using std::log;
-using std::stoi;
 using std::max;
 using std::abs;
 using std::tuple;
+using std::pair;
+using std::greater;
+using std::hash;
+using std::equal_to;
+using std::string_view;
+using std::get;
+using std::sort;
+using std::max_element;
+using std::unique;
+using std::move;
+using std::priority_queue;
+using std::atomic;
+using std::min;
+using std::unique_ptr;
 using pugi::xml_document;
 using pugi::xml_node;
-using pugi::xpath_node;
-using pugi::xpath_node_set;
 
 // forward declaration to avoid recursive dependencies
 class Query;
 
+// counts of the words of the page being processed, allocated from its batch's arena
+using TermCounts = unordered_map<string_view, int, hash<string_view>, equal_to<string_view>, ArenaAllocator<pair<const string_view, int>>>;
+
+// scratch space of one page processing worker, reused for every page so processing tokens never calls malloc
+struct PageScratch {
+    Arena arena; // backs the TermCounts of the page being processed, reset for every page
+    string word; // token being stemmed, reused so its capacity sticks around
+    int worker; // worker this scratch space belongs to
+    int max_count; // max num of occurences of any word in the page so far
+    int length; // stems in the page so far
+    int title_length; // stems in the title
+    vector<pair<string, int>> title_counts; // words and counts of the title, if the scorer needs them
+    vector<string> page_links; // raw link targets of the page so far
+    int position; // position of the next word token in the page, stop words included
+    vector<pair<const char*, int>> occurrences; // (word's key in the TermCounts, position) of every counted word, if positional
+    string positions; // position entries of the page, if positional
+
+    // counted locally and added to the metrics once per worker
+    long pages = 0;
+    long tokens = 0;
+    long stems = 0;
+    long links = 0;
+};
+
+// page as parsed out of the corpus, handed from the parsing stage to the processing stage
+struct RawPage {
+    int doc; // dense doc id, the position of the page in the corpus
+    string title;
+    string text;
+};
+
+// page as processed, handed from the processing stage to the accumulating stage
+struct ProcessedPage {
+    int doc; // dense doc id
+    string title; // lowercased
+    vector<pair<string, int>> term_counts; // words and counts
+    string positions; // position entries of the words, in term_counts order, if positional
+    vector<string> links; // raw link targets
+    DocStats stats; // length and max num of occurences of any word
+    vector<pair<string, int>> title_counts; // words and counts of the title, if the scorer needs them
+};
+
+// worker, parser, shard and queue sizes of an indexing run, whether to keep positions, how postings are scored,
+// quantized and ordered, how many a top k query processes, how far prefixes expand, how misspelled words are
+// matched and how many query results are cached, from INDEX_THREADS, INDEX_PARSERS, INDEX_SHARDS, INDEX_QUEUE_CAPACITY,
+// INDEX_POSITIONS, INDEX_SCORING, INDEX_IMPACT_BITS, INDEX_GLOBAL_SCALE, INDEX_IMPACT_ORDER, INDEX_POSTINGS_BUDGET,
+// INDEX_MAX_EXPANSIONS, INDEX_FUZZY, INDEX_CACHE_ENTRIES and INDEX_CACHE_MB or --threads, --parsers, --shards,
+// --queue-capacity, --positions, --scoring, --impact-bits, --global-scale, --impact-order, --postings-budget,
+// --max-expansions, --fuzzy, --cache-entries and --cache-mb
+struct IndexConfig {
+    int threads = 0; // worker threads, 0 for one per core, ingest's parsers and accumulator count against them
+    int shards = 0; // word partitions and term buckets, 0 for 16 per worker thread
+    int parsers = 0; // xml parsing or bzip2 decompression threads, 0 for one per 4 worker threads (2 from 5 on)
+    int queue_capacity = 0; // pages in flight between ingest stages, 0 for 64 per worker thread
+    bool positions = false; // keep the positions of every term in every doc, for phrase queries
+    Scoring scoring = TF_IDF; // scoring function of the postings: tfidf, bm25 or bm25f
+    int impact_bits = 0; // quantize posting scores to impacts of 8 or 16 bits, 0 keeps them exact
+    // one quantization scale for the whole index rather than one per term (the default). Costs accuracy: with
+    // 8 bits the exact top 10 comes back only 50-65% of the time, against 85-95% per term (bench/impact_eval)
+    bool global_scale = false;
+    bool impact_order = false; // also sort every term's postings by impact, for score-at-a-time top k queries
+    // postings a score-at-a-time query processes at most, 0 for as many as it needs. With impact_order, ranks
+    // queries score-at-a-time within it, which bounds their latency but costs accuracy: with a budget of 5000
+    // the exact top 10 of a query of common words comes back about 1% of the time (bench/anytime_bench)
+    long postings_budget = 0;
+    int max_expansions = 0; // terms a prefix like algebr* expands to at most, the ones in the most docs, 0 for 64
+    int fuzzy = 0; // most edits (1 or 2) a query word that isn't a term is corrected by, 0 to leave it be
+    long cache_entries = 4096; // query results kept for repeated queries, 0 to cache nothing
+    long cache_mb = 16; // memory the cached results take at most
+
+    static IndexConfig from_env();
+    int parse_args(int argc, char** argv);
+    int thread_count() const;
+    int parser_count() const;
+    int shard_count() const;
+    int page_queue_capacity() const;
+    int expansion_limit() const;
+    int impact_width() const;
+};
+
 class Index {
     private:
         friend class Query; // Query class can access Index fields
-        const char* xml_filepath = "xml/MedWiki.xml"; // sys.argv[1]
+        string xml_filepath; // sys.argv[1]
+        Metrics metrics; // timings and counters of the indexing run
+        string metrics_path; // where to write the metrics report, from INDEX_METRICS
         Processor processor; // text processor object
-        vector<xml_node> all_pages; // vector of id, title, text of pages!
 
-        array<shared_mutex, 10> doc_mutexes; // 10 mutexes, for last digit of doc id
-        array<shared_mutex, 26> word_mutexes; // 26 mutexes, for ((ch - 97) % 26), where ch is first letter of word
+        vector<double> page_ranks; // dense doc ids -> page ranks
 
-        array<unordered_map<string, int>, 10> titles_to_ids; // THREAD-SAFE | titles -> ids
-        array<unordered_map<string, int>, 10> titles_to_max_counts; // THREAD-SAFE | titles -> max num of occurences of any word
-        unordered_map<string, double> page_ranks; // titles -> page ranks
+        vector<string> doc_titles; // dense doc ids (position of the page in the corpus) -> titles
+        unordered_map<string, int> titles_to_doc_ids; // READ-ONLY after ingest_pages | titles -> dense doc ids
+        vector<vector<string>> page_links; // dense doc ids -> raw link targets
+        vector<vector<int>> out_links; // dense doc ids -> sorted, unique dense doc ids linked to (the edge list)
+        vector<double> page_weights; // dense doc ids -> weight given to each page linked to
+        double epsilon = 0.15; // hyperparameter for weight calculations
 
-        array<unordered_map<string, int>, 26> words_to_doc_counts; // THREAD-SAFE | words -> num of docs w/ this word
-        array<unordered_map<string, unordered_map<string, double>>, 26> term_relevances; // THREAD-SAFE | words -> titles -> relevances
+        vector<vector<unordered_map<string, int>>> worker_doc_counts; // page workers -> word partitions -> words -> num of docs w/ this word, only written by the worker
+        vector<unordered_map<string, int>> words_to_doc_counts; // word partitions -> words -> num of docs w/ this word
+        vector<string> term_words; // term ids -> words, until the dictionary is built
+        vector<int> term_doc_counts; // term ids -> num of docs w/ this term
+        unordered_map<string, int> words_to_term_ids; // READ-ONLY after batch_relevance | words -> term ids
+        vector<vector<pair<int, double>>> term_postings; // term ids -> (dense doc ids, relevances), sorted by doc id, until batch_relevance
+        Postings postings; // READ-ONLY after batch_relevance | term ids -> dense doc ids and exact or quantized relevances
+        bool impact_ordered; // whether postings are also kept by descending impact
+        ImpactPostings impact_postings; // READ-ONLY after batch_relevance | term ids -> segments of equal impact, if impact ordered
+        TermDictionary dictionary; // READ-ONLY after batch_relevance | every word in sorted order, for prefix lookups
 
-        array<unordered_map<string, unordered_map<string, double>>, 10> page_weights; // THREAD-SAFE | start titles -> end titles -> weights
-        array<unordered_map<string, unordered_map<string, int>>, 10> titles_to_processed_text; // THREAD-SAFE | titles -> words -> counts 
+        // a position entry is the varint byte length of the rest, then the varint gaps between the sorted
+        // positions of a word in a doc (the first gap from 0), so entries can be skipped without decoding them
+        bool positional; // whether positions are kept
+        vector<string> doc_positions; // dense doc ids -> position entries, in doc_term_counts order, until batch_relevance
+        vector<string> term_positions; // term ids -> position entries, in term_postings order
+
+        vector<vector<pair<string, int>>> doc_term_counts; // dense doc ids -> (words, counts)
+        vector<DocStats> doc_stats; // dense doc ids -> lengths and max num of occurences of any word
+        vector<vector<pair<string, int>>> doc_title_counts; // dense doc ids -> (words, counts) of the title, if the scorer needs them, until batch_relevance
+        unique_ptr<Scorer> scorer; // scores every posting once, in batch_relevance
+
+        int num_threads; // worker threads for every parallel phase
+        int num_parsers; // xml parsing threads if the corpus can be split, bzip2 decompression threads if it's streamed
+        int queue_capacity; // pages in flight between ingest stages
+        int num_shards; // word partitions for reducing doc counts, and term buckets spread over the worker threads by load
+        ThreadPool pool; // runs the tasks of every parallel phase, and at least the 3 stages of ingest at once
+        vector<vector<int>> thread_buckets; // worker threads -> term buckets they merge
+        vector<vector<vector<tuple<int, int, double, int>>>> relevance_buffers; // batches -> term buckets -> (term id, dense doc id, relevance, offset of its position entry)
 
     public:
+        Index(const string& filepath = "xml/MedWiki.xml", const IndexConfig& config = IndexConfig::from_env());
         int process_xml();
-        int find_d_id(string title);
+        string metrics_json();
+        void report_locks(const char* phase, const char* mutexes, const vector<LockStats>& slots);
         int calculate_n();
-        int calculate_nk(string start_title, int d_id);
+        long counter(Counter which) const;
+
+        int ingest_pages();
+        vector<PageRange> split_corpus(string_view corpus);
+        void parse_pages(PageReader& reader, BoundedQueue<RawPage>& pages);
+        void parse_ranges(string_view corpus, const vector<PageRange>& ranges, atomic<int>& next_range, BoundedQueue<RawPage>& pages);
+        void parse_page(xml_document& page_xml, string_view page_text, int doc, BoundedQueue<RawPage>& pages);
+        void process_pages(int worker, BoundedQueue<RawPage>& pages, BoundedQueue<ProcessedPage>& processed);
+        void accumulate_pages(BoundedQueue<ProcessedPage>& processed);
+        vector<pair<string, int>> process_text(string_view title, string_view text, PageScratch& scratch);
+        void process_tokens(string_view text, TermCounts& processed_text, PageScratch& scratch);
+        void process_word(string_view token, TermCounts& processed_text, PageScratch& scratch);
+        void encode_positions(const char* key, PageScratch& scratch);
+        void extract_tokens_from_link(string_view link, TermCounts& processed_text, PageScratch& scratch);
+        int word_partition(const string& word);
+        void merge_doc_counts(int partition);
 
-        void batch_pages();
-        void process_pages(int start_index, int batch_size);
-        vector<string> extract_tokens_from_link(string link, string title, int d_id);
-        unordered_map<string, int> process_text(string title, string text, int d_id);
+        void batch_links();
+        void resolve_links(int batch_num, int batch_size);
 
         void batch_relevance();
-        void calculate_relevance(int d_id, double n);
+        void assign_term_ids();
+        void balance_term_buckets();
+        int term_bucket(int term_id);
+        void calculate_relevance(int batch_num, int batch_size);
+        double merge_relevance(int thread_num);
+        void pack_postings(int batch_num, int batch_size);
 
         void batch_weights();
-        void calculate_weights(int d_id, double n, double epsilon);
-        void calculate_page_ranks();
-        double euclidean_distance(unordered_map<string, double> v1, unordered_map<string, double> v2);
+        void calculate_weights(int batch_num, int batch_size, double n);
+        int calculate_page_ranks();
+        double euclidean_distance(const vector<double>& v1, const vector<double>& v2);
 };
@@ -5,7 +5,6 @@
 */
 Processor::Processor() {
     STOP_WORDS = fill_stopwords();
-    regex_str = "\\[\\[[^\\[]+?\\]\\]|[a-zA-Z0-9]+'[a-zA-Z0-9]+|[a-zA-Z0-9]+";
 }
 
 /**
@@ -30,14 +29,100 @@ unordered_set<string> Processor::fill_stopwords() {
 }
 
 /**
- * Stems english word using porter stemming algorithm
+ * Stems english word in place using porter stemming algorithm
  * @param word: word to stem
- * @return stemmed word
+ * @return stemmed word (the same string)
 */
-string Processor::stem_word(string& word) {
+const string& Processor::stem_word(string& word) const {
     Porter2Stemmer::stem(word);
 
-    return string(word);
+    return word;
+}
+
+/**
+ * Finds the next token of a text, without allocating. Tokens are links (\[\[[^\[]+?\]\]),
+ * words with an apostrophe ([a-zA-Z0-9]+'[a-zA-Z0-9]+) or plain words ([a-zA-Z0-9]+),
+ * matched leftmost first, in that order of preference
+ * @param text: string to tokenize
+ * @param pos: where to start searching, moved past the token found
+ * @param token: set to the token found, a view into text
+ * @return true if a token was found, false if the text is exhausted
+*/
+bool Processor::next_token(string_view text, size_t& pos, string_view& token) const {
+    for (; pos < text.size(); pos++) {
+        size_t end = match_link(text, pos);
+
+        if (end == string::npos) {
+            end = match_word(text, pos);
+        }
+
+        if (end != string::npos) {
+            token = text.substr(pos, end - pos);
+            pos = end;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Matches a link starting at a given position
+ * @param text: string being tokenized
+ * @param pos: start of the match
+ * @return end of the link, or npos if there is no link at pos
+*/
+size_t Processor::match_link(string_view text, size_t pos) {
+    if (text.compare(pos, 2, "[[") != 0) {
+        return string::npos;
+    }
+
+    // shortest run of at least one non-'[' character followed by "]]"
+    for (size_t i = pos + 2; i < text.size() && text[i] != '['; i++) {
+        if (i > pos + 2 && text.compare(i, 2, "]]") == 0) {
+            return i + 2;
+        }
+    }
+
+    return string::npos;
+}
+
+/**
+ * Matches a word, with at most one apostrophe inside it, starting at a given position
+ * @param text: string being tokenized
+ * @param pos: start of the match
+ * @return end of the word, or npos if there is no word at pos
+*/
+size_t Processor::match_word(string_view text, size_t pos) {
+    size_t end = pos;
+
+    while (end < text.size() && is_alnum(text[end])) {
+        end++;
+    }
+
+    if (end == pos) {
+        return string::npos;
+    }
+
+    if (end + 1 < text.size() && text[end] == '\'' && is_alnum(text[end + 1])) {
+        end++;
+
+        while (end < text.size() && is_alnum(text[end])) {
+            end++;
+        }
+    }
+
+    return end;
+}
+
+/**
+ * Determines if a character can be part of a word
+ * @param c: character to check
+ * @return true if c is in [a-zA-Z0-9]
+*/
+bool Processor::is_alnum(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
 }
 
 /**
@@ -45,15 +130,13 @@ string Processor::stem_word(string& word) {
  * @param text: string to tokenize
  * @return a vector of strings (all tokens)
 */
-vector<string> Processor::tokenize(const string& text) {
+vector<string> Processor::tokenize(const string& text) const {
     vector<string> tokens;
-    smatch match;
-    regex pattern(regex_str);
-    string::const_iterator search_start(text.cbegin());
+    string_view token;
+    size_t pos = 0;
 
-    while (regex_search(search_start, text.cend(), match, pattern)) {
-        tokens.push_back(lower(match.str()));
-        search_start = match.suffix().first;
+    while (next_token(text, pos, token)) {
+        tokens.push_back(lower(token));
     }
 
     return tokens;
@@ -64,7 +147,7 @@ vector<string> Processor::tokenize(const string& text) {
  * @param token: token to check 
  * @return true if token is link, false otherwise
 */
-bool Processor::is_link(const string& token) {
+bool Processor::is_link(string_view token) const {
     return token.size() >= 4 && token.substr(0, 2) == "[[" && token.substr(token.size() - 2, 2) == "]]";
 }
 
@@ -73,6 +156,6 @@ bool Processor::is_link(const string& token) {
  * @param token: token to check 
  * @return true if token is a stop word, false otherwise
 */
-bool Processor::is_stop_word(const string& token) {
+bool Processor::is_stop_word(const string& token) const {
     return STOP_WORDS.count(token) > 0;
 }
\ No newline at end of file
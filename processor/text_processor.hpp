@@ -4,7 +4,7 @@
 #include <unordered_set>
 #include <vector>
 #include <string>
-#include <regex>
+#include <string_view>
 #include <fstream>
 #include "stemmer/porter2_stemmer.hpp"
 #include "util/util.hpp"
@@ -12,22 +12,25 @@ using std::unordered_set;
 using std::string;
 using std::ifstream;
 using std::vector;
-using std::regex;
+using std::string_view;
 using std::tolower;
-using std::smatch;
 
 class Processor {
     private:
         unordered_set<string> STOP_WORDS;
-        string regex_str;
+
+        static bool is_alnum(char c);
+        static size_t match_link(string_view text, size_t pos);
+        static size_t match_word(string_view text, size_t pos);
 
     public:
         Processor();
         unordered_set<string> fill_stopwords();
-        string stem_word(string& word);
-        vector<string> tokenize(const string& text);
-        bool is_link(const string& token);
-        bool is_stop_word(const string& token);
+        const string& stem_word(string& word) const;
+        bool next_token(string_view text, size_t& pos, string_view& token) const;
+        vector<string> tokenize(const string& text) const;
+        bool is_link(string_view token) const;
+        bool is_stop_word(const string& token) const;
 };
 
 #endif // PROCESSOR_H
\ No newline at end of file
@@ -1,79 +1,899 @@
 #include "query.hpp"
 
+static const PostingList NO_POSTINGS{}; // postings of a word that is nowhere in the corpus
+
 /**
- * Constructor for Query
+ * Constructor for Query, indexes the corpus
+ * @param filepath: path of the xml corpus to index
+ * @param config: worker and shard counts for indexing, how far prefixes expand, how misspellings are corrected
+ * and how many postings a score-at-a-time query processes
 */
-Query::Query() {
+Query::Query(const string& filepath, const IndexConfig& config) :
+    index(filepath, config), max_expansions(config.expansion_limit()), max_edits(max(0, min(2, config.fuzzy))),
+    postings_budget(max(0L, config.postings_budget)) {
     index.process_xml();
+
+    if (!index.page_ranks.empty()) {
+        max_page_rank = *max_element(index.page_ranks.begin(), index.page_ranks.end());
+    }
 }
 
 /**
- * Tokenizes input query and produces tokens for scoring
+ * Tokenizes input query and produces tokens for scoring, words ending in * standing for every term
+ * they are a prefix of, and, when fuzzy matching is on, words that aren't terms for the nearest terms
  * @param input: string to process
  * @return vector of tokens
 */
-vector<string> Query::tokenize_input(string input) {
+vector<string> Query::tokenize_input(const string& input) const {
     vector<string> tokens;
+    string rest = input; // the input without its prefixes
+
+    if (input.find('*') != string::npos) {
+        size_t start = 0;
+        rest.clear();
+
+        while (start < input.size()) {
+            size_t end = input.find(' ', start);
+            end = end == string::npos ? input.size() : end;
+            string word = input.substr(start, end - start);
+
+            if (word.size() > 1 && word.back() == '*') {
+                for (string& term: expand_prefix(word)) {
+                    tokens.push_back(std::move(term));
+                }
+            }
+            else {
+                rest += word + ' ';
+            }
+
+            start = end + 1;
+        }
+    }
+
+    for (string& token: index.processor.tokenize(rest)) {
+        if (index.processor.is_stop_word(token)) {
+            continue;
+        }
+
+        index.processor.stem_word(token);
+
+        if (max_edits > 0 && !index.words_to_term_ids.count(token)) {
+            for (string& term: correct_word(token)) {
+                tokens.push_back(std::move(term));
+            }
+        }
+        else {
+            tokens.push_back(std::move(token));
+        }
+    }
+
+    return tokens;
+}
+
+/**
+ * Finds the terms nearest to a word that isn't one, by running a Levenshtein automaton of the word
+ * over the term dictionary. Short words get fewer edits: none up to 2 characters, 1 up to 5
+ * @param stem: stemmed word to correct
+ * @return the terms at the smallest edit distance found, at most max_expansions of them (the ones
+ * in the most docs), most docs first, none if nothing is close enough
+*/
+vector<string> Query::correct_word(const string& stem) const {
+    int edits = min(max_edits, stem.size() <= 2 ? 0 : stem.size() <= 5 ? 1 : 2);
+    vector<pair<int, string>> terms; // (num of docs w/ the term, term)
+    vector<string> words;
+
+    if (edits == 0) {
+        return words;
+    }
+
+    vector<FuzzyMatch> matches = fuzzy_terms(index.dictionary, LevenshteinAutomaton(stem, edits));
+    int nearest = edits;
+
+    for (const FuzzyMatch& match: matches) {
+        nearest = min(nearest, match.distance);
+    }
+
+    for (FuzzyMatch& match: matches) {
+        if (match.distance == nearest) {
+            terms.emplace_back(index.term_doc_counts[match.term_id], std::move(match.word));
+        }
+    }
+
+    // ties stay in sorted term order
+    stable_sort(terms.begin(), terms.end(), [](const pair<int, string>& a, const pair<int, string>& b) { return a.first > b.first; });
+    terms.resize(min((int) terms.size(), max_expansions));
+
+    for (auto& term: terms) {
+        words.push_back(std::move(term.second));
+    }
+
+    return words;
+}
+
+/**
+ * Expands a prefix into the terms starting with it, by walking the sorted term dictionary from
+ * the prefix on. The prefix is matched against stems, so algebr* finds algebra and algebraic but
+ * runn* doesn't find running (its stem is run)
+ * @param pattern: prefix, with or without the trailing *
+ * @return the terms, at most max_expansions of them (the ones in the most docs), most docs first
+*/
+vector<string> Query::expand_prefix(const string& pattern) const {
+    string prefix = pattern.back() == '*' ? pattern.substr(0, pattern.size() - 1) : pattern;
+    vector<pair<int, string>> terms; // (num of docs w/ the term, term)
+    vector<string> words;
+
+    for (char& c: prefix) {
+        c = tolower(c);
+    }
+
+    if (prefix.empty()) {
+        return words; // * alone would be every term!
+    }
+
+    TermIterator it(index.dictionary);
+
+    for (it.seek(prefix); !it.done() && it.term().compare(0, prefix.size(), prefix) == 0; it.next()) {
+        terms.emplace_back(index.term_doc_counts[it.term_id()], it.term());
+    }
+
+    auto more_docs = [](const pair<int, string>& a, const pair<int, string>& b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    };
+
+    if ((int) terms.size() > max_expansions) {
+        nth_element(terms.begin(), terms.begin() + max_expansions, terms.end(), more_docs); // keep the terms in the most docs
+        terms.resize(max_expansions);
+    }
+
+    sort(terms.begin(), terms.end(), more_docs);
+
+    for (auto& term: terms) {
+        words.push_back(std::move(term.second));
+    }
+
+    return words;
+}
+
+/**
+ * Tokenizes a phrase, keeping track of where each token is in the phrase
+ * @param input: phrase to process
+ * @return (stemmed token, offset in the phrase), stop words are dropped but still take up an offset
+*/
+vector<pair<string, int>> Query::tokenize_phrase(const string& input) const {
+    vector<pair<string, int>> tokens;
+    int offset = 0;
 
-    for (string token: index.processor.tokenize(input)) {
+    for (string& token: index.processor.tokenize(input)) {
         if (!index.processor.is_stop_word(token)) {
-            tokens.push_back(index.processor.stem_word(token));
+            tokens.emplace_back(index.processor.stem_word(token), offset);
         }
+
+        offset++;
     }
 
     return tokens;
 }
 
+// walks the postings of a term in doc order, keeping track of where each posting's position entry starts
+struct PositionCursor {
+    PostingsCursor postings;
+    const string* entries; // position entries, null without positions
+    size_t offset = 0; // start of the current posting's position entry
+
+    /**
+     * Moves to the next posting, skipping the current one's position entry
+     * @return dense doc id of the next posting, DocCursor::END if there are no more
+    */
+    int next() {
+        if (entries) {
+            offset += get_varint(entries->data(), offset); // past the length, then past the entry
+        }
+
+        postings.next();
+
+        return postings.doc();
+    }
+
+    /**
+     * Moves to the first posting at or after a doc, skipping the position entries on the way
+     * @param doc: dense doc id to move to
+     * @return whether the term is in that doc
+    */
+    bool advance_to(int doc) {
+        while (postings.doc() < doc) {
+            next();
+        }
+
+        return postings.doc() == doc;
+    }
+
+    /**
+     * Decodes the positions of the term in the current posting's doc
+     * @param positions: set to the positions, ascending
+    */
+    void decode(vector<int>& positions) const {
+        size_t pos = offset;
+        size_t end = get_varint(entries->data(), pos);
+        end += pos;
+        int position = 0;
+        positions.clear();
+
+        while (pos < end) {
+            position += get_varint(entries->data(), pos);
+            positions.push_back(position);
+        }
+    }
+};
+
+/**
+ * Whether the index kept positions, without them phrases only require all of their terms
+ * @return true if phrases are matched exactly
+*/
+bool Query::has_positions() const {
+    return index.positional;
+}
+
+/**
+ * Finds the documents containing a phrase, by intersecting the postings of its terms (rarest first)
+ * and then checking that the terms' positions line up
+ * @param phrase: (stemmed token, offset in the phrase), from tokenize_phrase
+ * @param slop: how far each term may be from where the phrase puts it, 0 for an exact phrase
+ * @return (dense doc id, sum of the terms' relevances) of every matching document, by doc id
+*/
+vector<pair<int, double>> Query::phrase_matches(const vector<pair<string, int>>& phrase, int slop) const {
+    vector<pair<int, double>> matches;
+    vector<PositionCursor> cursors;
+    vector<int> offsets; // cursor -> offset of its term in the phrase
+
+    for (const auto& token: phrase) {
+        auto it = index.words_to_term_ids.find(token.first);
+
+        if (it == index.words_to_term_ids.end()) {
+            return matches; // a term that is nowhere can't be in a phrase!
+        }
+
+        cursors.push_back({PostingsCursor(index.postings.list(it->second)), index.positional ? &index.term_positions[it->second] : nullptr});
+        offsets.push_back(token.second);
+    }
+
+    if (cursors.empty()) {
+        return matches;
+    }
+
+    // the rarest term drives the intersection
+    int rarest = 0;
+
+    for (int i = 1; i < (int) cursors.size(); i++) {
+        if (cursors[i].postings.cost() < cursors[rarest].postings.cost()) {
+            rarest = i;
+        }
+    }
+
+    vector<vector<int>> positions(cursors.size());
+
+    for (int doc = cursors[rarest].postings.doc(); doc != DocCursor::END; doc = cursors[rarest].next()) {
+        bool in_all = true;
+
+        for (int i = 0; i < (int) cursors.size() && in_all; i++) {
+            in_all = cursors[i].advance_to(doc);
+        }
+
+        if (!in_all) {
+            continue;
+        }
+
+        // some position of the first term must have every other term where the phrase puts it
+        bool lined_up = !index.positional;
+
+        if (index.positional) {
+            for (int i = 0; i < (int) cursors.size(); i++) {
+                cursors[i].decode(positions[i]);
+            }
+
+            for (int start: positions[0]) {
+                lined_up = true;
+
+                for (int i = 1; i < (int) cursors.size() && lined_up; i++) {
+                    int expected = start + offsets[i] - offsets[0];
+                    auto it = lower_bound(positions[i].begin(), positions[i].end(), expected - slop);
+                    lined_up = it != positions[i].end() && *it <= expected + slop;
+                }
+
+                if (lined_up) {
+                    break;
+                }
+            }
+        }
+
+        if (lined_up) {
+            double relevance = 0;
+
+            for (const PositionCursor& cursor: cursors) {
+                relevance += cursor.postings.score();
+            }
+
+            matches.emplace_back(doc, relevance);
+        }
+    }
+
+    return matches;
+}
+
+/**
+ * Calculates scores of the documents containing a phrase, summing the term-document scores of its terms
+ * @param phrase: (stemmed token, offset in the phrase), from tokenize_phrase
+ * @param slop: how far each term may be from where the phrase puts it, 0 for an exact phrase
+ * @param use_page_rank: whether to include pagerank or not in scoring
+ * @return scores of all documents, by dense doc id, 0 for those without the phrase, borrowed until the result goes out of scope
+*/
+PooledAccumulators Query::calculate_phrase_scores(const vector<pair<string, int>>& phrase, int slop, bool use_page_rank) const {
+    PooledAccumulators document_scores = accumulator_pool.borrow(index.doc_titles.size()); // dense doc ids -> scores
+
+    for (const auto& match: phrase_matches(phrase, slop)) {
+        document_scores->add(match.first, match.second * (use_page_rank ? index.page_ranks[match.first] : 1));
+    }
+
+    return document_scores;
+}
+
+/**
+ * Makes a cursor over the documents of any of some terms, merging their postings with a heap
+ * @param words: terms, from expand_prefix or correct_word
+ * @return the cursor, matching nothing without terms
+*/
+unique_ptr<DocCursor> Query::any_term(const vector<string>& words) const {
+    vector<unique_ptr<DocCursor>> postings;
+
+    for (const string& word: words) {
+        postings.emplace_back(new PostingsCursor(index.postings.list(index.words_to_term_ids.at(word))));
+    }
+
+    if (postings.empty()) {
+        return unique_ptr<DocCursor>(new PostingsCursor(NO_POSTINGS));
+    }
+
+    return postings.size() == 1 ? std::move(postings[0]) : unique_ptr<DocCursor>(new OrCursor(std::move(postings)));
+}
+
+/**
+ * Turns a node of a boolean query into a cursor over the documents it matches
+ * @param node: node of the operator tree
+ * @return the cursor, null if the node doesn't constrain anything (only stop words)
+*/
+unique_ptr<DocCursor> Query::compile(const QueryNode& node) const {
+    int num_docs = index.doc_titles.size();
+
+    if (node.op == TERM && node.text.size() > 1 && node.text.back() == '*') {
+        return any_term(expand_prefix(node.text));
+    }
+
+    if (node.op == TERM || node.op == PHRASE) {
+        vector<pair<string, int>> phrase = tokenize_phrase(node.text);
+
+        if (phrase.empty()) {
+            return nullptr;
+        }
+
+        if (phrase.size() == 1) {
+            auto it = index.words_to_term_ids.find(phrase[0].first);
+
+            if (it == index.words_to_term_ids.end()) {
+                return any_term(max_edits > 0 && node.op == TERM ? correct_word(phrase[0].first) : vector<string>());
+            }
+
+            return unique_ptr<DocCursor>(new PostingsCursor(index.postings.list(it->second)));
+        }
+
+        return unique_ptr<DocCursor>(new PostingsCursor(phrase_matches(phrase, node.op == PHRASE ? node.slop : 0))); // new-york is a phrase too
+    }
+
+    if (node.op == NOT) {
+        unique_ptr<DocCursor> excluded = compile(*node.children[0]);
+
+        return excluded ? unique_ptr<DocCursor>(new AndNotCursor(unique_ptr<DocCursor>(new AllDocsCursor(num_docs)), std::move(excluded))) : nullptr;
+    }
+
+    vector<unique_ptr<DocCursor>> included;
+    vector<unique_ptr<DocCursor>> excluded; // negated children of an AND, skipped past rather than complemented
+
+    for (const auto& child: node.children) {
+        bool negated = node.op == AND && child->op == NOT;
+        unique_ptr<DocCursor> cursor = compile(negated ? *child->children[0] : *child);
+
+        if (cursor) {
+            (negated ? excluded : included).push_back(std::move(cursor));
+        }
+    }
+
+    if (included.empty() && excluded.empty()) {
+        return nullptr;
+    }
+
+    unique_ptr<DocCursor> cursor;
+
+    if (included.empty()) {
+        cursor.reset(new AllDocsCursor(num_docs));
+    }
+    else if (included.size() == 1) {
+        cursor = std::move(included[0]);
+    }
+    else if (node.op == AND) {
+        cursor.reset(new AndCursor(std::move(included)));
+    }
+    else {
+        cursor.reset(new OrCursor(std::move(included)));
+    }
+
+    if (!excluded.empty()) {
+        unique_ptr<DocCursor> any_excluded = excluded.size() == 1 ? std::move(excluded[0]) : unique_ptr<DocCursor>(new OrCursor(std::move(excluded)));
+        cursor.reset(new AndNotCursor(std::move(cursor), std::move(any_excluded)));
+    }
+
+    return cursor;
+}
+
+/**
+ * Finds the documents matching a boolean query by walking cursors over the postings of its terms,
+ * so only the postings the operators need are visited and nothing is scored for the whole corpus
+ * @param root: operator tree of the query, from parse_query
+ * @return (dense doc id, sum of the relevances of the matched terms) of every match, by doc id
+*/
+vector<pair<int, double>> Query::boolean_matches(const QueryNode& root) const {
+    vector<pair<int, double>> matches;
+    unique_ptr<DocCursor> cursor = compile(root);
+
+    if (!cursor) {
+        return matches; // nothing but stop words
+    }
+
+    for (; cursor->doc() != DocCursor::END; cursor->next()) {
+        matches.emplace_back(cursor->doc(), cursor->score());
+    }
+
+    return matches;
+}
+
 /**
  * Calculates scores by summing the term-document scores for all terms in the query
  * @param processed_tokens: all terms in the query
  * @param use_page_rank: whether to include pagerank or not in scoring
+ * @return scores of all documents, by dense doc id, borrowed until the result goes out of scope
 */
-void Query::calculate_scores(vector<string> processed_tokens, bool use_page_rank) {
-    for (const auto& x: index.page_ranks) {
-        string title = x.first;
-        double score = 0;
+PooledAccumulators Query::calculate_scores(const vector<string>& processed_tokens, bool use_page_rank) const {
+    PooledAccumulators document_scores = accumulator_pool.borrow(index.doc_titles.size()); // dense doc ids -> scores
+
+    for (const string& word: processed_tokens) {
+        auto it = index.words_to_term_ids.find(word);
+
+        if (it == index.words_to_term_ids.end()) {
+            continue; // not in the corpus!
+        }
+
+        document_scores->add(index.postings.list(it->second));
+    }
+
+    if (use_page_rank) {
+        document_scores->weight(index.page_ranks.data());
+    }
+
+    return document_scores;
+}
+
+// order of (doc, score) results: higher scores first, ties going to the lowest doc id
+struct Better {
+    bool operator()(const pair<int, double>& a, const pair<int, double>& b) const {
+        return a.second > b.second || (a.second == b.second && a.first < b.first);
+    }
+};
+
+// keeps the k best of the (doc, score) pairs offered to it, ties going to the lowest doc id
+class TopDocuments {
+    private:
+        int k;
+        priority_queue<pair<int, double>, vector<pair<int, double>>, Better> top; // worst of the top k on top
+
+    public:
+        TopDocuments(int most) : k(most) {}
+
+        /**
+         * Score a document has to beat to get in, when documents are offered by ascending doc id
+         * (a tie loses to the documents already in, their doc ids are lower)
+         * @return 0 until there are k documents, so only positive scores get in, then the worst of the top k
+        */
+        double threshold() const {
+            if (k <= 0) {
+                return HUGE_VAL;
+            }
+
+            return (int) top.size() < k ? 0 : top.top().second;
+        }
+
+        /**
+         * Keeps a document if it is among the k best so far
+         * @param doc: dense doc id
+         * @param score: score of the document
+        */
+        void offer(int doc, double score) {
+            if ((int) top.size() < k) {
+                top.emplace(doc, score);
+            }
+            else if (k > 0 && Better()({doc, score}, top.top())) {
+                top.pop();
+                top.emplace(doc, score);
+            }
+        }
+
+        /**
+         * Empties the top k
+         * @return (dense doc id, score) of the best documents offered, best first
+        */
+        vector<pair<int, double>> take() {
+            vector<pair<int, double>> results(top.size());
+
+            for (int i = results.size() - 1; i >= 0; i--) {
+                results[i] = top.top();
+                top.pop();
+            }
 
-        for (string& word: processed_tokens) {
-            int w_id = ((word.front() - 97) % 26) / 2;
-            score += index.term_relevances[w_id][word][title];
+            return results;
         }
+};
 
-        document_scores[title] = score;
+// the k + 1 best documents of a score-at-a-time query so far, ties going to the lowest doc id. Scores only
+// go up, so a document is offered again whenever its score does, and the ones left out can only get in by
+// beating the worst of them: the set stays exact, and its last document is the best of all the others.
+// Few offers get past the worst, so the set is kept sorted as they come
+class LeadingDocuments {
+    private:
+        size_t most;
+        vector<pair<int, double>> leaders; // (dense doc id, score), best first
 
-        if (use_page_rank) {
-            document_scores[title] *= index.page_ranks[title];
+    public:
+        LeadingDocuments(int k) : most(max(k, 0) + 1) {}
+
+        /**
+         * Takes a document in, or moves it up, if it is among the best so far
+         * @param doc: dense doc id
+         * @param score: positive score of the document, at least what it was last offered with
+        */
+        void offer(int doc, double score) {
+            if (leaders.size() == most && !Better()({doc, score}, leaders.back())) {
+                return;
+            }
+
+            auto it = find_if(leaders.begin(), leaders.end(), [doc](const pair<int, double>& leader) { return leader.first == doc; });
+
+            if (it == leaders.end()) {
+                if (leaders.size() == most) {
+                    leaders.pop_back();
+                }
+
+                leaders.emplace_back(doc, score);
+                it = leaders.end() - 1;
+            }
+
+            it->second = score;
+
+            for (; it != leaders.begin() && Better()(*it, *(it - 1)); --it) {
+                iter_swap(it, it - 1); // its score only grew, so it only moves up
+            }
+        }
+
+        /**
+         * Score a document has to reach to be worth offering
+         * @return 0 until there are k + 1 leaders, so every positive score is, then the worst of them
+        */
+        double threshold() const {
+            return leaders.size() < most ? 0 : leaders.back().second;
+        }
+
+        /**
+         * Leaders, best first
+         * @return (dense doc id, score) of the k + 1 best documents so far, fewer if fewer have a score
+        */
+        const vector<pair<int, double>>& ranked() const {
+            return leaders;
+        }
+};
+
+/**
+ * Finds the k highest-scored documents, ties going to the lowest doc id. Only the touched documents are
+ * looked at if they are all that have a score, otherwise the scan skips straight to the next score above
+ * the top k's threshold, so once the top k has filled up most scores are only compared
+ * @param document_scores: scores of all documents, by dense doc id
+ * @param k: max number of documents to return
+ * @return (dense doc id, score) of the documents with a positive score, best first
+*/
+vector<pair<int, double>> Query::top_documents(const Accumulators& document_scores, int k) const {
+    TopDocuments top(k);
+
+    if (document_scores.sparse()) {
+        for (int doc: document_scores.touched_docs()) {
+            if (document_scores[doc] > 0) {
+                top.offer(doc, document_scores[doc]);
+            }
         }
+
+        return top.take();
     }
+
+    const double* scores = document_scores.data();
+    size_t n = document_scores.size();
+
+    for (size_t doc = next_above(scores, 0, n, top.threshold()); doc < n; doc = next_above(scores, doc + 1, n, top.threshold())) {
+        top.offer(doc, scores[doc]);
+    }
+
+    return top.take();
 }
 
 /**
- * Prints the 10 highest-scored documents matching with the query
+ * Whether postings are also kept by impact, for anytime_top_documents
+ * @return true if the index is impact ordered
+*/
+bool Query::has_impact_order() const {
+    return index.impact_ordered;
+}
+
+/**
+ * Whether the top k of a score-at-a-time query is settled: every document's final score is somewhere
+ * between its score so far and what it would be if it got all that is left, so the top k can't change
+ * once each of them is surely ahead of the next one, and the last of them surely ahead of every other
+ * document, seen or not. The best of the others is the k + 1th leader, so the cost is O(k)
+ * @param best: the k + 1 best documents so far with their scores, page rank included, best first
+ * @param scores: dense doc ids -> scores so far, without page rank
+ * @param k: number of documents ranked
+ * @param remaining: most a document can still gain, the contributions of the terms' next segments added up
+ * @param use_page_rank: whether to include pagerank or not in scoring
+ * @return true if processing the rest of the postings would give the same top k
 */
-void Query::rank_documents() {
-    for (int i = 0; i < 10; i++) {
-        double max_score = 0;
-        string max_title = "";
+bool Query::top_k_stable(const vector<pair<int, double>>& best, const Accumulators& scores, int k, double remaining, bool use_page_rank) const {
+    if (k <= 0) {
+        return true;
+    }
+
+    if ((int) best.size() < k) {
+        return remaining == 0; // with fewer than k, any document that can still get a score gets in
+    }
+
+    double best_other = (int) best.size() > k ? best[k].second : 0; // seen or not
+
+    if (best_other + remaining * (use_page_rank ? max_page_rank : 1) >= best[k - 1].second) {
+        return false; // another document might still get in
+    }
 
-        for (const auto& x: document_scores) {
-            string title = x.first;
+    for (int i = 1; i < k; i++) {
+        int doc = best[i].first;
 
-            if (document_scores[title] > max_score) {
-                max_score = document_scores[title];
-                max_title = title;
+        if ((scores[doc] + remaining) * (use_page_rank ? index.page_ranks[doc] : 1) >= best[i - 1].second) {
+            return false; // might still overtake the one ahead
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Finds the k highest-scored documents score-at-a-time: the impact segments of every term of the query
+ * are processed by how much they add to a score, largest first, across terms, so the postings that
+ * matter most are seen first. Each segment is added whole by the scoring kernels, then its documents are
+ * offered to the k + 1 leaders, so the k-th best score is known at every segment boundary, where the
+ * query stops once the top k can't change anymore. Also stops once the postings budget is spent,
+ * returning the best top k so far. Scores are the same as calculate_scores on the quantized postings.
+ * Only wins over calculate_scores when it stops early, which takes a top k far ahead of the rest
+ * @param processed_tokens: all terms in the query
+ * @param k: max number of documents to return
+ * @param use_page_rank: whether to include pagerank or not in scoring
+ * @param stats: set to how many postings were processed and why it stopped, if not null
+ * @param budget: postings to process at most, 0 for as many as needed, -1 for the budget the index was configured with
+ * @return (dense doc id, score) of the documents with a positive score, best first
+*/
+vector<pair<int, double>> Query::anytime_top_documents(const vector<string>& processed_tokens, int k, bool use_page_rank, AnytimeStats* stats, long budget) const {
+    struct Pending {
+        double contribution; // what each posting of the segment adds to its document's score
+        int token;
+        int segment;
+    };
+
+    AnytimeStats local;
+    AnytimeStats& run = stats ? *stats : local;
+    run = AnytimeStats();
+    vector<int> term_ids; // tokens in the corpus -> term ids, repeated tokens counting again like in calculate_scores
+    vector<double> next_contribution; // tokens -> most their unprocessed segments add to a score
+    vector<Pending> pending;
+
+    for (const string& word: processed_tokens) {
+        auto it = index.words_to_term_ids.find(word);
+
+        if (it == index.words_to_term_ids.end()) {
+            continue; // not in the corpus!
+        }
+
+        int token = term_ids.size();
+        double scale = index.postings.list(it->second).scale;
+        term_ids.push_back(it->second);
+        next_contribution.push_back(0);
+
+        for (int i = 0; i < index.impact_postings.num_segments(it->second); i++) {
+            ImpactSegment segment = index.impact_postings.segment(it->second, i);
+
+            if (segment.impact > 0) {
+                pending.push_back({segment.impact * scale, token, i});
+                next_contribution[token] = max(next_contribution[token], segment.impact * scale);
+                run.total += segment.size;
             }
         }
+    }
+
+    // a term's segments are by descending impact, so they stay in order
+    sort(pending.begin(), pending.end(), [](const Pending& a, const Pending& b) {
+        return a.contribution > b.contribution || (a.contribution == b.contribution && (a.token < b.token || (a.token == b.token && a.segment < b.segment)));
+    });
+
+    PooledAccumulators borrowed = accumulator_pool.borrow(index.doc_titles.size());
+    Accumulators& scores = *borrowed; // dense doc ids -> scores so far, without page rank
+    LeadingDocuments leaders(k); // scores with page rank
+    const double* page_ranks = use_page_rank ? index.page_ranks.data() : nullptr;
+    vector<int> docs; // doc ids of the segment being processed, decoded
+    budget = budget < 0 ? postings_budget : budget;
+
+    for (const Pending& next: pending) {
+        ImpactSegment segment = index.impact_postings.segment(term_ids[next.token], next.segment);
+        size_t size = segment.size;
+
+        if (budget > 0) {
+            size = min(size, (size_t) (budget - run.postings));
+        }
+
+        docs.resize(size);
+        segment.decode(docs.data(), size);
+        scores.add(docs.data(), size, next.contribution);
+
+        for (size_t i = next_reaching(scores.data(), page_ranks, docs.data(), 0, size, leaders.threshold()); i < size;
+             i = next_reaching(scores.data(), page_ranks, docs.data(), i + 1, size, leaders.threshold())) {
+            int doc = docs[i];
+            double score = page_ranks ? scores[doc] * page_ranks[doc] : scores[doc];
 
-        if (max_title == "") {
-            if (i == 0) {
-                cout << "NO SEARCH RESULTS MATCHED YOUR QUERY. TRY AGAIN. \n";
+            if (score > 0) {
+                leaders.offer(doc, score);
             }
+        }
+
+        run.postings += size;
 
+        if (size < segment.size || (budget > 0 && run.postings == budget)) {
+            run.out_of_budget = run.postings < run.total;
             break;
         }
-        else {
-            cout << i + 1 << ": " << max_title << '\n';
-            document_scores.erase(max_title);
+
+        int following = next.segment + 1;
+        int term_id = term_ids[next.token];
+        next_contribution[next.token] = following < index.impact_postings.num_segments(term_id) ?
+            index.impact_postings.segment(term_id, following).impact * index.postings.list(term_id).scale : 0;
+
+        if (run.postings < run.total) {
+            double remaining = 0;
+
+            for (double contribution: next_contribution) {
+                remaining += contribution;
+            }
+
+            if (top_k_stable(leaders.ranked(), scores, k, remaining, use_page_rank)) {
+                run.stable = true;
+                break;
+            }
         }
     }
+
+    vector<pair<int, double>> results = leaders.ranked();
+    results.resize(min((size_t) max(k, 0), results.size()));
+
+    return results;
+}
+
+/**
+ * Caches the results of top_results from now on. Whatever the cache held was ranked on another index,
+ * so it is invalidated, and results of queries still running on that index are turned away
+ * @param cache: cache to keep results in, outliving this
+*/
+void Query::attach_cache(ResultCache& cache) {
+    cache.invalidate();
+    result_cache = &cache;
+    cache_generation = cache.generation();
+}
+
+/**
+ * Finds the k highest-scored documents score-at-a-time within the postings budget if the index is impact
+ * ordered and has one, which bounds the latency of queries of common words but may miss some of their top
+ * k, term-at-a-time otherwise: without a budget anytime_top_documents seldom stops early enough to make
+ * up for tracking its leaders (bench/anytime_bench). Or looks them up if the same terms were ranked the
+ * same way since the cache was attached
+ * @param processed_tokens: all terms in the query
+ * @param k: max number of documents to return
+ * @param use_page_rank: whether to include pagerank or not in scoring
+ * @return (dense doc id, score) of the documents with a positive score, best first
+*/
+vector<pair<int, double>> Query::top_results(const vector<string>& processed_tokens, int k, bool use_page_rank) const {
+    bool budgeted = has_impact_order() && postings_budget > 0;
+    vector<pair<int, double>> results;
+    string key;
+
+    if (result_cache) {
+        key = ResultCache::make_key(processed_tokens, k, use_page_rank, budgeted ? postings_budget : 0);
+
+        if (result_cache->get(key, results)) {
+            return results;
+        }
+    }
+
+    if (budgeted) {
+        results = anytime_top_documents(processed_tokens, k, use_page_rank);
+    }
+    else {
+        results = top_documents(*calculate_scores(processed_tokens, use_page_rank), k);
+    }
+
+    if (result_cache) {
+        result_cache->put(key, results, cache_generation);
+    }
+
+    return results;
+}
+
+/**
+ * Finds the k highest-scored documents matching a boolean query, ties going to the lowest doc id,
+ * so documents only matched by negation come out in corpus order
+ * @param matches: (dense doc id, score) of every matching document, from boolean_matches
+ * @param k: max number of documents to return
+ * @param use_page_rank: whether to include pagerank or not in scoring
+ * @return (dense doc id, score) of the best matching documents, best first
+*/
+vector<pair<int, double>> Query::top_matches(const vector<pair<int, double>>& matches, int k, bool use_page_rank) const {
+    TopDocuments top(k);
+
+    for (const auto& match: matches) {
+        top.offer(match.first, match.second * (use_page_rank ? index.page_ranks[match.first] : 1));
+    }
+
+    return top.take();
+}
+
+/**
+ * Prints the 10 highest-scored documents matching with the query
+ * @param document_scores: scores of all documents, by dense doc id
+*/
+void Query::rank_documents(const Accumulators& document_scores) const {
+    print_results(top_documents(document_scores, 10));
+}
+
+/**
+ * Prints the titles of ranked documents
+ * @param results: (dense doc id, score) of the documents, best first
+*/
+void Query::print_results(const vector<pair<int, double>>& results) const {
+    if (results.empty()) {
+        cout << "NO SEARCH RESULTS MATCHED YOUR QUERY. TRY AGAIN. \n";
+    }
+
+    for (int i = 0; i < (int) results.size(); i++) {
+        cout << i + 1 << ": " << title(results[i].first) << '\n';
+    }
+}
+
+/**
+ * Finds the title of a document
+ * @param doc: dense doc id
+ * @return title of the document
+*/
+const string& Query::title(int doc) const {
+    return index.doc_titles[doc];
+}
+
+/**
+ * Reads a counter of the indexing run
+ * @param which: counter to read
+ * @return its value
+*/
+long Query::counter(Counter which) const {
+    return index.counter(which);
 }
\ No newline at end of file
@@ -6,6 +6,12 @@
 #include <cmath>
 #include "processor/text_processor.hpp"
 #include "index.hpp"
+#include "query_parser.hpp"
+#include "util/doc_cursor.hpp"
+#include "util/levenshtein.hpp"
+#include "util/score_kernels.hpp"
+#include "util/accumulators.hpp"
+#include "util/result_cache.hpp"
 using std::unordered_map;
 using std::string;
 using std::cout;
@@ -14,15 +20,49 @@ using std::min;
 using pugi::xml_document;
 using pugi::xml_node;
 
-// locking scheme: by first letter of title
+// how much of its postings a score-at-a-time query processed, and why it stopped
+struct AnytimeStats {
+    long postings = 0; // postings processed
+    long total = 0; // postings of the query's terms
+    bool stable = false; // stopped early because the top k could no longer change
+    bool out_of_budget = false; // stopped because the postings budget was spent, the top k may be off
+};
+
+// read-only once constructed, but for the accumulators queries borrow, so any number of threads can query at once
 class Query {
     private:
         Index index; // Indexer object
-        unordered_map<string, double> document_scores; // titles -> document scores
+        int max_expansions; // terms a prefix or a misspelled word expands to at most
+        int max_edits; // most edits a misspelled word is corrected by, 0 for exact words only
+        long postings_budget; // postings a score-at-a-time query processes at most, 0 for as many as it needs
+        double max_page_rank = 1; // highest page rank of any document
+        mutable AccumulatorPool accumulator_pool; // scores of a query, borrowed for the query and given back cleared for the next
+        ResultCache* result_cache = nullptr; // results of top_results, if cached
+        long cache_generation = 0; // generation of the cache when this index was attached to it
+
+        unique_ptr<DocCursor> any_term(const vector<string>& words) const;
+        unique_ptr<DocCursor> compile(const QueryNode& node) const;
+        bool top_k_stable(const vector<pair<int, double>>& best, const Accumulators& scores, int k, double remaining, bool use_page_rank) const;
 
     public:
-        Query();
-        vector<string> tokenize_input(string input);
-        void calculate_scores(vector<string> processed_tokens, bool use_page_rank);
-        void rank_documents();
+        Query(const string& filepath = "xml/MedWiki.xml", const IndexConfig& config = IndexConfig::from_env());
+        vector<string> tokenize_input(const string& input) const;
+        vector<string> expand_prefix(const string& pattern) const;
+        vector<string> correct_word(const string& stem) const;
+        vector<pair<string, int>> tokenize_phrase(const string& input) const;
+        PooledAccumulators calculate_scores(const vector<string>& processed_tokens, bool use_page_rank) const;
+        bool has_positions() const;
+        vector<pair<int, double>> phrase_matches(const vector<pair<string, int>>& phrase, int slop) const;
+        PooledAccumulators calculate_phrase_scores(const vector<pair<string, int>>& phrase, int slop, bool use_page_rank) const;
+        vector<pair<int, double>> boolean_matches(const QueryNode& root) const;
+        vector<pair<int, double>> top_matches(const vector<pair<int, double>>& matches, int k, bool use_page_rank) const;
+        vector<pair<int, double>> top_documents(const Accumulators& document_scores, int k) const;
+        bool has_impact_order() const;
+        vector<pair<int, double>> anytime_top_documents(const vector<string>& processed_tokens, int k, bool use_page_rank, AnytimeStats* stats = nullptr, long budget = -1) const;
+        void attach_cache(ResultCache& cache);
+        vector<pair<int, double>> top_results(const vector<string>& processed_tokens, int k, bool use_page_rank) const;
+        void rank_documents(const Accumulators& document_scores) const;
+        void print_results(const vector<pair<int, double>>& results) const;
+        const string& title(int doc) const;
+        long counter(Counter which) const;
 };
\ No newline at end of file
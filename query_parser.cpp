@@ -0,0 +1,306 @@
+#include "query_parser.hpp"
+#include <cctype>
+#include <algorithm>
+using std::min;
+
+// kinds of lexical tokens of a boolean query
+enum LexKind {
+    WORD_TOKEN,
+    PHRASE_TOKEN,
+    AND_TOKEN,
+    OR_TOKEN,
+    NOT_TOKEN,
+    OPEN_TOKEN,
+    CLOSE_TOKEN,
+    END_TOKEN,
+    BAD_TOKEN // malformed phrase, the error says why
+};
+
+struct LexToken {
+    LexKind kind;
+    string text; // WORD_TOKEN: the word, PHRASE_TOKEN: the words between the quotes
+    int slop = 0; // PHRASE_TOKEN: number after ~, 0 without one
+};
+
+// recursive descent parser, one function per precedence level:
+//     or    := and (OR and)*
+//     and   := unary (AND? unary)*       adjacent operands are ANDed
+//     unary := NOT unary | primary
+//     primary := ( or ) | "words"~N | word
+class QueryParser {
+    private:
+        const string& input;
+        size_t pos = 0;
+        LexToken current;
+        string error;
+
+        /**
+         * Reads the next token of the input into current
+        */
+        void advance() {
+            while (pos < input.size() && isspace((unsigned char) input[pos])) {
+                pos++;
+            }
+
+            current = LexToken{END_TOKEN, ""};
+
+            if (pos >= input.size()) {
+                return;
+            }
+
+            char c = input[pos];
+
+            if (c == '(' || c == ')') {
+                current.kind = c == '(' ? OPEN_TOKEN : CLOSE_TOKEN;
+                pos++;
+            }
+            else if (c == '"') {
+                size_t close = input.find('"', pos + 1);
+
+                if (close == string::npos) {
+                    fail("missing closing quote");
+                    return;
+                }
+
+                current = LexToken{PHRASE_TOKEN, input.substr(pos + 1, close - pos - 1)};
+                pos = close + 1;
+
+                if (pos < input.size() && input[pos] == '~') {
+                    size_t digits = ++pos;
+                    long slop = 0;
+
+                    while (pos < input.size() && isdigit((unsigned char) input[pos])) {
+                        slop = min((long) MAX_SLOP, slop * 10 + (input[pos] - '0')); // clamped as it's read, so it can't overflow
+                        pos++;
+                    }
+
+                    if (pos == digits) {
+                        fail("expected a number after ~");
+                        return;
+                    }
+
+                    current.slop = slop;
+                }
+            }
+            else {
+                size_t start = pos;
+
+                while (pos < input.size() && !isspace((unsigned char) input[pos]) && input[pos] != '(' && input[pos] != ')' && input[pos] != '"') {
+                    pos++;
+                }
+
+                string word = input.substr(start, pos - start);
+                current.kind = word == "AND" ? AND_TOKEN : word == "OR" ? OR_TOKEN : word == "NOT" ? NOT_TOKEN : WORD_TOKEN;
+                current.text = word;
+            }
+        }
+
+        /**
+         * Records the first syntax error and stops the parse
+         * @param message: what went wrong
+        */
+        void fail(const string& message) {
+            if (error.empty()) {
+                error = message;
+            }
+
+            current = LexToken{BAD_TOKEN, ""};
+        }
+
+        /**
+         * Makes an AND or OR node, unless it only has one child
+         * @param op: AND or OR
+         * @param children: operands
+         * @return the node
+        */
+        static unique_ptr<QueryNode> combine(QueryOp op, vector<unique_ptr<QueryNode>> children) {
+            if (children.size() == 1) {
+                return std::move(children[0]);
+            }
+
+            unique_ptr<QueryNode> node(new QueryNode(op));
+
+            for (auto& child: children) {
+                if (child->op == op) {
+                    // a AND (b AND c) is a AND b AND c
+                    for (auto& grandchild: child->children) {
+                        node->children.push_back(std::move(grandchild));
+                    }
+                }
+                else {
+                    node->children.push_back(std::move(child));
+                }
+            }
+
+            return node;
+        }
+
+        unique_ptr<QueryNode> parse_or() {
+            vector<unique_ptr<QueryNode>> children;
+            children.push_back(parse_and());
+
+            while (children.back() && current.kind == OR_TOKEN) {
+                advance();
+                children.push_back(parse_and());
+            }
+
+            return children.back() ? combine(OR, std::move(children)) : nullptr;
+        }
+
+        unique_ptr<QueryNode> parse_and() {
+            vector<unique_ptr<QueryNode>> children;
+            children.push_back(parse_unary());
+
+            while (children.back()) {
+                if (current.kind == AND_TOKEN) {
+                    advance();
+                }
+                else if (current.kind != WORD_TOKEN && current.kind != PHRASE_TOKEN && current.kind != NOT_TOKEN && current.kind != OPEN_TOKEN) {
+                    break;
+                }
+
+                children.push_back(parse_unary());
+            }
+
+            return children.back() ? combine(AND, std::move(children)) : nullptr;
+        }
+
+        unique_ptr<QueryNode> parse_unary() {
+            if (current.kind != NOT_TOKEN) {
+                return parse_primary();
+            }
+
+            advance();
+            unique_ptr<QueryNode> child = parse_unary();
+
+            if (!child) {
+                return nullptr;
+            }
+
+            if (child->op == NOT) {
+                return std::move(child->children[0]); // NOT NOT a is a
+            }
+
+            unique_ptr<QueryNode> node(new QueryNode(NOT));
+            node->children.push_back(std::move(child));
+
+            return node;
+        }
+
+        unique_ptr<QueryNode> parse_primary() {
+            LexToken token = current;
+
+            switch (token.kind) {
+                case WORD_TOKEN:
+                case PHRASE_TOKEN: {
+                    advance();
+                    unique_ptr<QueryNode> node(new QueryNode(token.kind == WORD_TOKEN ? TERM : PHRASE, token.text));
+                    node->slop = token.slop;
+
+                    return node;
+                }
+                case OPEN_TOKEN: {
+                    advance();
+                    unique_ptr<QueryNode> node = parse_or();
+
+                    if (node && current.kind != CLOSE_TOKEN) {
+                        fail("missing )");
+                        return nullptr;
+                    }
+
+                    advance();
+
+                    return node;
+                }
+                case CLOSE_TOKEN:
+                    fail("unexpected )");
+                    return nullptr;
+                case END_TOKEN:
+                    fail("expected a word, a phrase or ( at the end of the query");
+                    return nullptr;
+                case BAD_TOKEN:
+                    return nullptr;
+                default:
+                    fail("expected a word, a phrase or ( before " + string(token.kind == AND_TOKEN ? "AND" : "OR"));
+                    return nullptr;
+            }
+        }
+
+    public:
+        QueryParser(const string& text) : input(text) {}
+
+        /**
+         * Parses the whole input
+         * @param message: set to the syntax error, if any
+         * @return root of the operator tree, null on a syntax error
+        */
+        unique_ptr<QueryNode> parse(string& message) {
+            advance();
+            unique_ptr<QueryNode> root = parse_or();
+
+            if (root && current.kind != END_TOKEN) {
+                fail(current.kind == CLOSE_TOKEN ? "unexpected )" : "unexpected text after the query");
+                root = nullptr;
+            }
+
+            message = error;
+
+            return root;
+        }
+};
+
+/**
+ * Whether any phrase is part of the query
+ * @return true if the tree has a PHRASE node
+*/
+bool QueryNode::has_phrase() const {
+    if (op == PHRASE) {
+        return true;
+    }
+
+    for (const auto& child: children) {
+        if (child->has_phrase()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Whether a query uses the boolean query language rather than being a bag of words
+ * @param input: query as typed
+ * @return true if it has AND, OR, NOT, parentheses or quotes
+*/
+bool is_boolean_query(const string& input) {
+    if (input.find_first_of("()\"") != string::npos) {
+        return true;
+    }
+
+    size_t start = 0;
+
+    while (start < input.size()) {
+        size_t end = input.find(' ', start);
+        end = end == string::npos ? input.size() : end;
+        string word = input.substr(start, end - start);
+
+        if (word == "AND" || word == "OR" || word == "NOT") {
+            return true;
+        }
+
+        start = end + 1;
+    }
+
+    return false;
+}
+
+/**
+ * Parses a boolean query: words and "quoted phrases" (with an optional ~N slop, at most MAX_SLOP) combined
+ * with AND, OR, NOT and parentheses, NOT binding tightest and OR loosest, adjacent operands being ANDed
+ * @param input: query as typed
+ * @param error: set to what is wrong with the query, if it doesn't parse
+ * @return root of the operator tree, null if the query doesn't parse
+*/
+unique_ptr<QueryNode> parse_query(const string& input, string& error) {
+    return QueryParser(input).parse(error);
+}
@@ -0,0 +1,38 @@
+#ifndef QUERY_PARSER_H
+#define QUERY_PARSER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+using std::string;
+using std::vector;
+using std::unique_ptr;
+
+// most a phrase's ~N slop can be, larger numbers are clamped to it (already more than the words of
+// any page are apart)
+const int MAX_SLOP = 1000000;
+
+// operators of the boolean query language
+enum QueryOp {
+    TERM, // a word
+    PHRASE, // words between quotes, in order
+    AND, // every child
+    OR, // any child
+    NOT // not the only child
+};
+
+// node of the operator tree of a boolean query, words are kept as typed and stemmed when evaluated
+struct QueryNode {
+    QueryOp op;
+    string text; // TERM: the word, PHRASE: the words between the quotes
+    int slop = 0; // PHRASE: how far each word may be from where the phrase puts it, from "..."~N
+    vector<unique_ptr<QueryNode>> children; // AND, OR: two or more, NOT: one
+
+    QueryNode(QueryOp type, const string& words = "") : op(type), text(words) {}
+    bool has_phrase() const;
+};
+
+bool is_boolean_query(const string& input);
+unique_ptr<QueryNode> parse_query(const string& input, string& error);
+
+#endif // QUERY_PARSER_H
@@ -2,9 +2,28 @@
 using std::getline;
 using std::cin;
 using std::cout;
+using std::cerr;
 
-int main() {
-    Query query;
+int main(int argc, char** argv) {
+    IndexConfig config = IndexConfig::from_env(); // flags win over the environment
+    string corpus = "xml/MedWiki.xml";
+
+    // corpus first, if given, can be compressed (.gz, .bz2, .zst, .zip)
+    if (argc > 1 && argv[1][0] != '-') {
+        corpus = argv[1];
+        argv[1] = argv[0];
+        argc--;
+        argv++;
+    }
+
+    if (config.parse_args(argc, argv) != 0) {
+        cerr << "usage: " << argv[0] << " [corpus] [--threads N] [--parsers N] [--shards N] [--queue-capacity N] [--positions 0|1] [--scoring tfidf|bm25|bm25f] [--impact-bits 0|8|16] [--global-scale 0|1] [--impact-order 0|1] [--postings-budget N] [--max-expansions N] [--fuzzy 0|1|2] [--cache-entries N] [--cache-mb N]\n";
+        return 1;
+    }
+
+    unique_ptr<Query> query(new Query(corpus, config));
+    ResultCache cache(config.cache_entries, config.cache_mb << 20);
+    query->attach_cache(cache);
     string input;
 
     while (true) {
@@ -15,8 +34,42 @@ int main() {
             break;
         }
 
-        vector<string> tokens = query.tokenize_input(input);
-        query.calculate_scores(tokens, true); // always pagerank!
-        query.rank_documents();
+        // indexes the corpus again, say after it changed, and drops the cached results
+        if (input == ":reload") {
+            query.reset(); // the old index goes first, only one is in memory at a time
+            query.reset(new Query(corpus, config));
+            query->attach_cache(cache);
+            continue;
+        }
+
+        if (input == ":cache") {
+            CacheStats stats = cache.stats();
+            long lookups = stats.hits + stats.misses;
+            cout << stats.hits << " hits, " << stats.misses << " misses (" << (lookups > 0 ? 100 * stats.hits / lookups : 0) << "% hit rate), "
+                 << stats.entries << " results in " << stats.bytes / 1024 << " KB, " << stats.evictions << " evicted, "
+                 << stats.invalidations << " invalidations\n";
+            continue;
+        }
+
+        // boolean queries, like: (rome OR carthage) AND "punic war"~2 NOT elephants
+        if (is_boolean_query(input)) {
+            string error;
+            unique_ptr<QueryNode> root = parse_query(input, error);
+
+            if (!root) {
+                cout << "could not parse the query: " << error << '\n';
+                continue;
+            }
+
+            if (!query->has_positions() && root->has_phrase()) {
+                cout << "(no positions indexed, phrases match pages with all their words, run with --positions 1 for phrases)\n";
+            }
+
+            query->print_results(query->top_matches(query->boolean_matches(*root), 10, true));
+            continue;
+        }
+
+        vector<string> tokens = query->tokenize_input(input);
+        query->print_results(query->top_results(tokens, 10, true)); // always pagerank!
     }
 }
\ No newline at end of file
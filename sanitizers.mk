@@ -10,6 +10,7 @@ ISLINUX := $(if $(wildcard /usr/include/linux/*.h),1,)
 # - ASAN=1 for the address sanitizer
 # - LSAN=1 for the leak sanitizer
 # - UBSAN=1 for the undefined behavior sanitizer
+# - TSAN=1 for the thread sanitizer (not part of SAN=1, it can't be combined with ASAN/LSAN)
 ifndef SAN
 SAN := $(SANITIZE)
 endif
@@ -33,3 +34,9 @@ CFLAGS += -fsanitize=undefined
 CXXFLAGS += -fsanitize=undefined
  endif
 endif
+ifeq ($(or $(TSAN),$(THREADSAN)),1)
+ ifeq ($(call check_for_sanitizer,thread),1)
+CFLAGS += -fsanitize=thread
+CXXFLAGS += -fsanitize=thread
+ endif
+endif
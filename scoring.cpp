@@ -0,0 +1,100 @@
+#include "scoring.hpp"
+#include <cmath>
+using std::log;
+
+/**
+ * Reads the name of a scoring function
+ * @param name: tfidf, bm25 or bm25f
+ * @param scoring: set to the scoring function named
+ * @return whether the name is known
+*/
+bool parse_scoring(const string& name, Scoring& scoring) {
+    if (name == "tfidf") scoring = TF_IDF;
+    else if (name == "bm25") scoring = BM25;
+    else if (name == "bm25f") scoring = BM25F;
+    else return false;
+
+    return true;
+}
+
+/**
+ * Makes the scorer of a scoring function
+ * @param scoring: scoring function
+ * @return the scorer, with its default parameters
+*/
+unique_ptr<Scorer> make_scorer(Scoring scoring) {
+    switch (scoring) {
+        case BM25:
+            return unique_ptr<Scorer>(new Bm25Scorer());
+        case BM25F:
+            return unique_ptr<Scorer>(new Bm25fScorer());
+        default:
+            return unique_ptr<Scorer>(new TfIdfScorer());
+    }
+}
+
+void TfIdfScorer::prepare(const CollectionStats& corpus) {
+    num_docs = corpus.num_docs;
+}
+
+/**
+ * tf normalized by the count of the doc's most frequent word, times log(n / df)
+*/
+double TfIdfScorer::score(const TermInDoc& term, const DocStats& doc) const {
+    double idf = log(num_docs / term.doc_count);
+    double tf = (double) term.count / doc.max_count;
+
+    return tf * idf;
+}
+
+/**
+ * Constructor for Bm25Scorer
+ * @param saturation: k1, how fast tf saturates
+ * @param length_weight: b, how much doc length normalizes tf
+*/
+Bm25Scorer::Bm25Scorer(double saturation, double length_weight) : k1(saturation), b(length_weight) {}
+
+void Bm25Scorer::prepare(const CollectionStats& corpus) {
+    num_docs = corpus.num_docs;
+    avg_length = corpus.avg_length;
+}
+
+/**
+ * idf * tf * (k1 + 1) / (tf + k1 * (1 - b + b * length / average length)), with the idf of Lucene
+ * that stays positive for terms in more than half the docs
+*/
+double Bm25Scorer::score(const TermInDoc& term, const DocStats& doc) const {
+    double idf = log(1 + (num_docs - term.doc_count + 0.5) / (term.doc_count + 0.5));
+    double norm = 1 - b + b * doc.length / (avg_length > 0 ? avg_length : 1);
+
+    return idf * term.count * (k1 + 1) / (term.count + k1 * norm);
+}
+
+/**
+ * Constructor for Bm25fScorer
+ * @param saturation: k1, how fast the combined tf saturates
+ * @param boost: weight of a title occurence next to a body occurence
+ * @param title_length_weight: b of the title
+ * @param body_length_weight: b of the body
+*/
+Bm25fScorer::Bm25fScorer(double saturation, double boost, double title_length_weight, double body_length_weight) :
+    k1(saturation), title_boost(boost), title_b(title_length_weight), body_b(body_length_weight) {}
+
+void Bm25fScorer::prepare(const CollectionStats& corpus) {
+    num_docs = corpus.num_docs;
+    avg_title_length = corpus.avg_title_length;
+    avg_body_length = corpus.avg_length - corpus.avg_title_length;
+}
+
+/**
+ * The title and body tfs, each normalized by its field's length, are weighted and added up before
+ * saturating, so a term in the title counts for more without a title match alone dominating
+*/
+double Bm25fScorer::score(const TermInDoc& term, const DocStats& doc) const {
+    double idf = log(1 + (num_docs - term.doc_count + 0.5) / (term.doc_count + 0.5));
+    double title_norm = 1 - title_b + title_b * doc.title_length / (avg_title_length > 0 ? avg_title_length : 1);
+    double body_norm = 1 - body_b + body_b * (doc.length - doc.title_length) / (avg_body_length > 0 ? avg_body_length : 1);
+    double tf = title_boost * term.title_count / title_norm + (term.count - term.title_count) / body_norm;
+
+    return idf * tf / (k1 + tf);
+}
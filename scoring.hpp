@@ -0,0 +1,108 @@
+#ifndef SCORING_H
+#define SCORING_H
+
+#include <string>
+#include <memory>
+#include <cstdint>
+using std::string;
+using std::unique_ptr;
+
+// scoring functions a term-document score can be computed with
+enum Scoring {
+    TF_IDF, // tf normalized by the doc's most frequent word, times log(n / df)
+    BM25, // Okapi BM25, tf saturated and normalized by doc length
+    BM25F // BM25 over the title and the body as separate fields, the title boosted
+};
+
+bool parse_scoring(const string& name, Scoring& scoring);
+
+// statistics of one doc that scorers normalize by, 12 bytes a doc
+struct DocStats {
+    uint32_t length; // stems in the doc, title included
+    uint32_t max_count; // max num of occurences of any stem
+    uint16_t title_length; // stems in the title, capped at 65535
+};
+
+// statistics of the whole corpus
+struct CollectionStats {
+    double num_docs;
+    double avg_length; // average DocStats::length
+    double avg_title_length; // average DocStats::title_length
+};
+
+// what is known about one term in one doc when its score is computed
+struct TermInDoc {
+    int count; // occurences in the doc, title included
+    int title_count; // occurences in the title, only counted for scorers that ask for it
+    int doc_count; // docs the term is in
+};
+
+// computes the static score of every posting once, at index time, so a query only adds them up.
+// new scoring functions subclass it and get a Scoring value and a name in parse_scoring and make_scorer
+class Scorer {
+    public:
+        virtual ~Scorer() = default;
+
+        /**
+         * Takes in the statistics of the corpus, once it has been read and before any score is computed
+         * @param corpus: statistics of the corpus
+        */
+        virtual void prepare(const CollectionStats& corpus) = 0;
+
+        /**
+         * Whether the scorer needs TermInDoc::title_count, which costs keeping every title's counts until scoring
+         * @return true if title counts should be kept
+        */
+        virtual bool needs_title_counts() const { return false; }
+
+        /**
+         * Computes the score of a term in a doc
+         * @param term: counts of the term
+         * @param doc: statistics of the doc
+         * @return score, higher is more relevant
+        */
+        virtual double score(const TermInDoc& term, const DocStats& doc) const = 0;
+};
+
+class TfIdfScorer : public Scorer {
+    private:
+        double num_docs = 0;
+
+    public:
+        void prepare(const CollectionStats& corpus) override;
+        double score(const TermInDoc& term, const DocStats& doc) const override;
+};
+
+class Bm25Scorer : public Scorer {
+    private:
+        double num_docs = 0;
+        double avg_length = 0;
+        double k1; // how fast tf saturates
+        double b; // how much doc length normalizes tf, 0 for none, 1 for fully
+
+    public:
+        Bm25Scorer(double saturation = 1.2, double length_weight = 0.75);
+        void prepare(const CollectionStats& corpus) override;
+        double score(const TermInDoc& term, const DocStats& doc) const override;
+};
+
+class Bm25fScorer : public Scorer {
+    private:
+        double num_docs = 0;
+        double avg_title_length = 0;
+        double avg_body_length = 0;
+        double k1; // how fast the combined tf saturates
+        double title_boost; // weight of a title occurence next to a body occurence
+        double title_b; // length normalization of the title
+        double body_b; // length normalization of the body
+
+    public:
+        Bm25fScorer(double saturation = 1.2, double boost = 3.0, double title_length_weight = 0.5, double body_length_weight = 0.75);
+        void prepare(const CollectionStats& corpus) override;
+        bool needs_title_counts() const override { return true; }
+        double score(const TermInDoc& term, const DocStats& doc) const override;
+};
+
+unique_ptr<Scorer> make_scorer(Scoring scoring);
+
+#endif // SCORING_H
@@ -0,0 +1,164 @@
+#include "accumulators.hpp"
+#include "score_kernels.hpp"
+#include <algorithm>
+using std::lock_guard;
+using std::fill;
+
+/**
+ * Constructor for Accumulators, every score 0
+ * @param num_docs: docs in the corpus
+*/
+Accumulators::Accumulators(size_t num_docs) : scores(num_docs, 0) {}
+
+/**
+ * Adds the score of every posting of a list to its doc. The list is remembered rather than its docs,
+ * so it has to stay valid until the accumulators are cleared
+ * @param list: postings of a term
+*/
+void Accumulators::add(const PostingList& list) {
+    list.add_to(scores.data());
+    added.push_back(list);
+    added_postings += list.size;
+}
+
+/**
+ * Adds to the score of a doc
+ * @param doc: dense doc id
+ * @param score: positive score to add
+*/
+void Accumulators::add(int doc, double score) {
+    if (scores[doc] == 0 && score != 0) {
+        touched.push_back(doc);
+    }
+
+    scores[doc] += score;
+}
+
+/**
+ * Adds the same score to some docs, like a segment of postings of equal impact decoded by the caller.
+ * The docs are copied, so the caller can decode the next segment over them
+ * @param docs: dense doc ids, distinct and ascending
+ * @param n: number of docs
+ * @param score: positive score to add to each
+*/
+void Accumulators::add(const int* docs, size_t n, double score) {
+    add_constant(scores.data(), docs, n, score);
+    added_docs.insert(added_docs.end(), docs, docs + n);
+    added_postings += n;
+}
+
+/**
+ * Multiplies every score by the weight of its doc, like its page rank. Docs without a score stay at 0,
+ * so only the touched docs are weighted, unless whole lists were added
+ * @param weights: dense doc ids -> weights
+*/
+void Accumulators::weight(const double* weights) {
+    if (!sparse()) {
+        multiply_scores(scores.data(), weights, scores.size());
+        return;
+    }
+
+    for (int doc: touched) {
+        scores[doc] *= weights[doc];
+    }
+}
+
+/**
+ * Puts every score back to 0, writing only the docs that were written, unless the lists and docs added have
+ * postings in more than an eighth of the docs: then zeroing every score in order is faster
+*/
+void Accumulators::clear() {
+    for (int doc: touched) {
+        scores[doc] = 0;
+    }
+
+    if (added_postings > scores.size() / 8) {
+        fill(scores.begin(), scores.end(), 0);
+    }
+    else {
+        for (int doc: added_docs) {
+            scores[doc] = 0;
+        }
+
+        int block_docs[POSTING_BLOCK];
+
+        for (const PostingList& list: added) {
+            for (size_t block = 0; block < list.num_blocks(); block++) {
+                size_t n = list.decode_block(block, block_docs);
+
+                for (size_t i = 0; i < n; i++) {
+                    scores[block_docs[i]] = 0;
+                }
+            }
+        }
+    }
+
+    touched.clear(); // keeps their memory for the next query
+    added.clear();
+    added_docs.clear();
+    added_postings = 0;
+}
+
+/**
+ * Constructor for PooledAccumulators
+ * @param owner: pool to give the accumulators back to
+ * @param borrowed: accumulators, all 0
+*/
+PooledAccumulators::PooledAccumulators(AccumulatorPool* owner, unique_ptr<Accumulators> borrowed) :
+    pool(owner), accumulators(std::move(borrowed)) {}
+
+/**
+ * Destructor for PooledAccumulators, gives the accumulators back unless they were moved away
+*/
+PooledAccumulators::~PooledAccumulators() {
+    if (accumulators) {
+        pool->give_back(std::move(accumulators));
+    }
+}
+
+/**
+ * Borrows accumulators, making new ones only if every one made so far is borrowed. Idle ones made for
+ * a corpus of a different size are dropped
+ * @param num_docs: docs in the corpus
+ * @return accumulators, all 0, given back when the result goes out of scope
+*/
+PooledAccumulators AccumulatorPool::borrow(size_t num_docs) {
+    {
+        lock_guard<mutex> guard(idle_mutex);
+
+        while (!idle.empty()) {
+            unique_ptr<Accumulators> accumulators = std::move(idle.back());
+            idle.pop_back();
+
+            if (accumulators->size() == num_docs) {
+                return PooledAccumulators(this, std::move(accumulators));
+            }
+
+            created--;
+        }
+
+        created++;
+    }
+
+    return PooledAccumulators(this, unique_ptr<Accumulators>(new Accumulators(num_docs))); // allocated outside the lock
+}
+
+/**
+ * Clears accumulators and keeps them for the next borrower
+ * @param accumulators: borrowed accumulators
+*/
+void AccumulatorPool::give_back(unique_ptr<Accumulators> accumulators) {
+    accumulators->clear(); // outside the lock, it's the query's own array until it's back
+    lock_guard<mutex> guard(idle_mutex);
+    idle.push_back(std::move(accumulators));
+}
+
+/**
+ * Number of accumulators made so far, borrowed or idle, the most queries that ran at once
+ * @return accumulators
+*/
+size_t AccumulatorPool::size() {
+    lock_guard<mutex> guard(idle_mutex);
+
+    return created;
+}
@@ -0,0 +1,107 @@
+#ifndef ACCUMULATORS_H
+#define ACCUMULATORS_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstddef>
+#include "util/postings.hpp"
+using std::vector;
+using std::unique_ptr;
+using std::mutex;
+
+// scores of one query by dense doc id: 0 everywhere but the docs the query wrote to, which it keeps track
+// of, so clearing costs what the query touched rather than the size of the corpus
+class Accumulators {
+    private:
+        vector<double> scores; // dense doc ids -> scores
+        vector<int> touched; // docs written one by one
+        vector<PostingList> added; // lists added whole, their docs were written
+        vector<int> added_docs; // docs that got the same score added together, with repeats
+        size_t added_postings = 0; // postings of those lists and docs
+
+    public:
+        Accumulators(size_t num_docs);
+
+        void add(const PostingList& list);
+        void add(int doc, double score);
+        void add(const int* docs, size_t n, double score);
+        void weight(const double* weights);
+        void clear();
+
+        /**
+         * Score of a doc
+         * @param doc: dense doc id
+         * @return its score so far
+        */
+        double operator[](int doc) const {
+            return scores[doc];
+        }
+
+        /**
+         * Scores of every doc
+         * @return dense doc ids -> scores
+        */
+        const double* data() const {
+            return scores.data();
+        }
+
+        /**
+         * Number of docs
+         * @return docs
+        */
+        size_t size() const {
+            return scores.size();
+        }
+
+        /**
+         * Whether every doc with a score is in touched_docs, true unless whole lists or docs that got the
+         * same score were added
+         * @return true if only the touched docs need to be looked at
+        */
+        bool sparse() const {
+            return added.empty() && added_docs.empty();
+        }
+
+        /**
+         * Docs written one by one, each once
+         * @return dense doc ids, in the order they were first written
+        */
+        const vector<int>& touched_docs() const {
+            return touched;
+        }
+};
+
+class AccumulatorPool;
+
+// accumulators borrowed from a pool, given back cleared when this goes out of scope
+class PooledAccumulators {
+    private:
+        AccumulatorPool* pool;
+        unique_ptr<Accumulators> accumulators;
+
+    public:
+        PooledAccumulators(AccumulatorPool* owner, unique_ptr<Accumulators> borrowed);
+        PooledAccumulators(PooledAccumulators&& other) = default;
+        PooledAccumulators& operator=(PooledAccumulators&&) = delete;
+        ~PooledAccumulators();
+
+        Accumulators& operator*() const { return *accumulators; }
+        Accumulators* operator->() const { return accumulators.get(); }
+};
+
+// accumulators kept between queries: a query borrows one instead of allocating and zeroing an array the
+// size of the corpus, so once there are as many as queries running at once, scoring allocates nothing
+class AccumulatorPool {
+    private:
+        mutex idle_mutex; // guards idle and created
+        vector<unique_ptr<Accumulators>> idle; // cleared and ready to borrow
+        size_t created = 0;
+
+    public:
+        PooledAccumulators borrow(size_t num_docs);
+        void give_back(unique_ptr<Accumulators> accumulators);
+        size_t size();
+};
+
+#endif // ACCUMULATORS_H
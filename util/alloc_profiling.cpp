@@ -0,0 +1,67 @@
+#include "alloc_profiling.hpp"
+#ifdef ALLOC_PROFILING
+#include <atomic>
+#include <cstdlib>
+#include <new>
+using std::atomic;
+using std::size_t;
+
+static atomic<long> allocations(0); // calls to operator new
+static atomic<long> bytes(0); // bytes asked of operator new
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    void* ptr = malloc(size ? size : 1);
+
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    free(ptr);
+}
+#endif
+
+/**
+ * Number of calls to operator new so far
+ * @return allocations, 0 without ALLOC_PROFILING
+*/
+long allocation_count() {
+#ifdef ALLOC_PROFILING
+    return allocations.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Bytes asked of operator new so far, freed or not
+ * @return bytes, 0 without ALLOC_PROFILING
+*/
+long allocated_bytes() {
+#ifdef ALLOC_PROFILING
+    return bytes.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
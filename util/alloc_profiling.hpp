@@ -0,0 +1,11 @@
+#ifndef ALLOC_PROFILING_H
+#define ALLOC_PROFILING_H
+
+// counts every call to the global operator new of the program when built with ALLOC_PROFILING
+// ("make ALLOCPROF=1"), which replaces operator new and delete for the whole program. Without it
+// nothing is replaced and the counts stay 0
+
+long allocation_count();
+long allocated_bytes();
+
+#endif // ALLOC_PROFILING_H
@@ -0,0 +1,87 @@
+#include "arena.hpp"
+
+/**
+ * Constructor for Arena, no memory is allocated until the first allocation
+ * @param new_block_size: size of the blocks the arena grows by
+*/
+Arena::Arena(size_t new_block_size) : block_size(new_block_size) {}
+
+/**
+ * Destructor for Arena, frees every block
+*/
+Arena::~Arena() {
+    for (char* block: blocks) {
+        operator delete(block);
+    }
+}
+
+/**
+ * Allocates memory from the arena, growing it by a block if the current blocks are full
+ * @param bytes: number of bytes to allocate
+ * @param alignment: required alignment, a power of two no larger than the default new alignment
+ * @return pointer to the allocated memory, valid until the next reset
+*/
+void* Arena::allocate(size_t bytes, size_t alignment) {
+    while (curr_block < blocks.size()) {
+        size_t start = (offset + alignment - 1) & ~(alignment - 1);
+
+        if (start + bytes <= block_sizes[curr_block]) {
+            offset = start + bytes;
+
+            return blocks[curr_block] + start;
+        }
+
+        curr_block++; // doesn't fit, move on to the next block
+        offset = 0;
+    }
+
+    // out of blocks, so grow!
+    size_t size = bytes > block_size ? bytes : block_size;
+    blocks.push_back(static_cast<char*>(operator new(size)));
+    block_sizes.push_back(size);
+    offset = bytes;
+
+    return blocks[curr_block];
+}
+
+/**
+ * Copies a string into the arena
+ * @param str: string to copy
+ * @return view of the copy, valid until the next reset
+*/
+string_view Arena::copy(string_view str) {
+    char* data = static_cast<char*>(allocate(str.size(), 1));
+    memcpy(data, str.data(), str.size());
+
+    return string_view(data, str.size());
+}
+
+/**
+ * Rewinds the arena, invalidating everything allocated from it but keeping its blocks
+*/
+void Arena::reset() {
+    curr_block = 0;
+    offset = 0;
+}
+
+/**
+ * Calculates the number of bytes owned by the arena
+ * @return total size of all blocks
+*/
+size_t Arena::capacity() {
+    size_t total = 0;
+
+    for (size_t size: block_sizes) {
+        total += size;
+    }
+
+    return total;
+}
+
+/**
+ * Counts the blocks owned by the arena, each one an allocation
+ * @return number of blocks
+*/
+size_t Arena::block_count() {
+    return blocks.size();
+}
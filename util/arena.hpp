@@ -0,0 +1,65 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <vector>
+#include <string_view>
+#include <cstddef>
+#include <cstring>
+#include <new>
+using std::vector;
+using std::string_view;
+using std::size_t;
+
+// bump allocator: nothing is freed on its own, the whole arena is rewound by reset() and
+// its blocks are reused, so a warmed up arena never calls malloc
+class Arena {
+    private:
+        vector<char*> blocks; // blocks of memory owned by the arena
+        vector<size_t> block_sizes; // size of each block
+        size_t block_size; // size of newly allocated blocks
+        size_t curr_block = 0; // block allocations are bumped from
+        size_t offset = 0; // first free byte of the current block
+
+    public:
+        Arena(size_t new_block_size = 64 * 1024);
+        ~Arena();
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        void* allocate(size_t bytes, size_t alignment);
+        string_view copy(string_view str);
+        void reset();
+        size_t capacity();
+        size_t block_count();
+};
+
+// STL allocator handing out memory from an Arena, deallocation is a no-op
+template <typename T>
+class ArenaAllocator {
+    public:
+        using value_type = T;
+        Arena* arena;
+
+        ArenaAllocator(Arena& owner) : arena(&owner) {}
+
+        template <typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+        T* allocate(size_t n) {
+            return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T*, size_t) {} // freed all at once by reset!
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+    return a.arena == b.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+    return a.arena != b.arena;
+}
+
+#endif // ARENA_H
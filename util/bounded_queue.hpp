@@ -0,0 +1,249 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <cstddef>
+#include "util/profiled_mutex.hpp"
+using std::atomic;
+using std::unique_ptr;
+using std::size_t;
+
+// lock-free multi-producer multi-consumer queue of fixed capacity (Vyukov's bounded queue): every
+// cell has a sequence number telling producers and consumers whose turn it is, so a push or pop
+// is one compare-and-swap on the shared position plus one release store on the cell.
+// push blocks while the queue is full (backpressure), pop blocks while it is empty and not closed.
+// In LOCK_PROFILING builds ("make LOCKPROF=1") it also counts pushes and pops and times their waits,
+// so it can be reported like a lock
+template <typename T>
+class BoundedQueue {
+    private:
+        struct Cell {
+            atomic<size_t> sequence;
+            T item;
+        };
+
+        unique_ptr<Cell[]> cells;
+        size_t mask; // capacity - 1, capacity is a power of two
+        alignas(64) atomic<size_t> push_pos{0}; // own cache lines, producers and consumers don't share
+        alignas(64) atomic<size_t> pop_pos{0};
+        alignas(64) atomic<bool> closed{false};
+        atomic<long> full_waits{0}; // pushes that found the queue full
+        atomic<long> empty_waits{0}; // pops that found the queue empty
+#ifdef LOCK_PROFILING
+        atomic<long> operations{0}; // pushes and pops
+        atomic<long> wait_nanos{0}; // time they spent waiting
+#endif
+
+        /**
+         * Backs off after a failed attempt: spins, then yields, then sleeps
+         * @param attempt: number of failed attempts so far
+        */
+        static void back_off(int attempt) {
+            if (attempt < 16) {
+                return; // spin, the other side is probably mid-operation
+            }
+            else if (attempt < 64) {
+                std::this_thread::yield();
+            }
+            else {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+
+        /**
+         * Counts a push or pop, and how long it waited if it had to (only in LOCK_PROFILING builds)
+         * @param attempts: failed attempts before it went through
+         * @param start: when the first one failed
+        */
+        void profile(int attempts, std::chrono::steady_clock::time_point start) {
+#ifdef LOCK_PROFILING
+            operations.fetch_add(1, std::memory_order_relaxed);
+
+            if (attempts > 0) {
+                auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+                wait_nanos.fetch_add(waited.count(), std::memory_order_relaxed);
+            }
+#else
+            (void) attempts;
+            (void) start;
+#endif
+        }
+
+    public:
+        /**
+         * Constructor for BoundedQueue
+         * @param min_capacity: capacity, rounded up to a power of two
+        */
+        BoundedQueue(size_t min_capacity) {
+            size_t capacity = 2;
+
+            while (capacity < min_capacity) {
+                capacity *= 2;
+            }
+
+            cells.reset(new Cell[capacity]);
+            mask = capacity - 1;
+
+            for (size_t i = 0; i < capacity; i++) {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        /**
+         * Pushes an item unless the queue is full
+         * @param item: item to push, moved from only on success
+         * @return whether the item was pushed
+        */
+        bool try_push(T& item) {
+            size_t pos = push_pos.load(std::memory_order_relaxed);
+
+            while (true) {
+                Cell& cell = cells[pos & mask];
+                size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                long diff = (long) sequence - (long) pos;
+
+                if (diff == 0) {
+                    // the cell is free for this position, claim it
+                    if (push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        cell.item = std::move(item);
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+
+                        return true;
+                    }
+                }
+                else if (diff < 0) {
+                    return false; // full, the cell still holds an item from the previous lap
+                }
+                else {
+                    pos = push_pos.load(std::memory_order_relaxed); // another producer got here first
+                }
+            }
+        }
+
+        /**
+         * Pops an item unless the queue is empty
+         * @param item: set to the popped item on success
+         * @return whether an item was popped
+        */
+        bool try_pop(T& item) {
+            size_t pos = pop_pos.load(std::memory_order_relaxed);
+
+            while (true) {
+                Cell& cell = cells[pos & mask];
+                size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                long diff = (long) sequence - (long) (pos + 1);
+
+                if (diff == 0) {
+                    // the cell holds the item for this position, claim it
+                    if (pop_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        item = std::move(cell.item);
+                        cell.sequence.store(pos + mask + 1, std::memory_order_release);
+
+                        return true;
+                    }
+                }
+                else if (diff < 0) {
+                    return false; // empty, nothing has been pushed for this position yet
+                }
+                else {
+                    pos = pop_pos.load(std::memory_order_relaxed); // another consumer got here first
+                }
+            }
+        }
+
+        /**
+         * Pushes an item, waiting for room while the queue is full
+         * @param item: item to push
+        */
+        void push(T item) {
+            std::chrono::steady_clock::time_point start;
+            int attempt = 0;
+
+            for (; !try_push(item); attempt++) {
+                if (attempt == 0) {
+                    full_waits.fetch_add(1, std::memory_order_relaxed);
+                    start = std::chrono::steady_clock::now();
+                }
+
+                back_off(attempt);
+            }
+
+            profile(attempt, start);
+        }
+
+        /**
+         * Pops an item, waiting while the queue is empty until it is closed
+         * @param item: set to the popped item on success
+         * @return whether an item was popped, false once the queue is closed and drained
+        */
+        bool pop(T& item) {
+            std::chrono::steady_clock::time_point start;
+            int attempt = 0;
+
+            for (; !try_pop(item); attempt++) {
+                if (closed.load(std::memory_order_acquire)) {
+                    bool popped = try_pop(item); // every push happened before close, one last look
+                    profile(attempt, start);
+
+                    return popped;
+                }
+
+                if (attempt == 0) {
+                    empty_waits.fetch_add(1, std::memory_order_relaxed);
+                    start = std::chrono::steady_clock::now();
+                }
+
+                back_off(attempt);
+            }
+
+            profile(attempt, start);
+
+            return true;
+        }
+
+        /**
+         * Marks the end of the stream, once every producer is done pushing
+        */
+        void close() {
+            closed.store(true, std::memory_order_release);
+        }
+
+        /**
+         * Number of pushes that had to wait for room so far
+         * @return full waits
+        */
+        long full_wait_count() const {
+            return full_waits.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Number of pops that had to wait for an item so far
+         * @return empty waits
+        */
+        long empty_wait_count() const {
+            return empty_waits.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Contention of the queue since it was made, as if it were a lock: pushes and pops, those that
+         * waited, and how long they waited
+         * @return stats (all 0 without LOCK_PROFILING)
+        */
+        LockStats wait_stats() const {
+            LockStats stats;
+#ifdef LOCK_PROFILING
+            stats.acquisitions = operations.load(std::memory_order_relaxed);
+            stats.contended = full_wait_count() + empty_wait_count();
+            stats.wait_nanos = wait_nanos.load(std::memory_order_relaxed);
+#endif
+            return stats;
+        }
+};
+
+#endif // BOUNDED_QUEUE_H
@@ -0,0 +1,507 @@
+#include "byte_source.hpp"
+#include "mapped_file.hpp"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <zlib.h>
+#include <bzlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+using std::vector;
+using std::thread;
+using std::mutex;
+using std::unique_lock;
+using std::condition_variable;
+using std::move;
+
+const size_t INPUT_CHUNK = 256 * 1024; // compressed bytes read from the file at a time
+const size_t MIN_SEGMENT = 1 << 20; // compressed bytes of bzip2 streams decompressed as one task
+
+/**
+ * Tells the format of a corpus by its first bytes
+ * @param head: first bytes of the corpus, at least 10 to tell every format apart
+ * @return format, PLAIN if it isn't a known compressed format
+*/
+CorpusFormat detect_format(string_view head) {
+    if (head.size() >= 2 && (unsigned char) head[0] == 0x1f && (unsigned char) head[1] == 0x8b) {
+        return GZIP;
+    }
+    else if (head.size() >= 4 && head.substr(0, 3) == "BZh" && head[3] >= '1' && head[3] <= '9') {
+        return BZIP2;
+    }
+    else if (head.size() >= 4 && head.substr(0, 4) == string_view("\x28\xb5\x2f\xfd", 4)) {
+        return ZSTD;
+    }
+    else if (head.size() >= 4 && head.substr(0, 4) == string_view("PK\x03\x04", 4)) {
+        return ZIP;
+    }
+
+    return PLAIN;
+}
+
+// raw bytes of a file or a pipe, starting with the bytes already read to detect its format
+// (a pipe can't be rewound)
+class FileInput {
+    private:
+        FILE* file;
+        string head; // read ahead, handed out before anything else
+
+    public:
+        FileInput(FILE* input, string read_ahead) : file(input), head(move(read_ahead)) {}
+        ~FileInput() { fclose(file); }
+        FileInput(const FileInput&) = delete;
+        FileInput& operator=(const FileInput&) = delete;
+
+        size_t read(char* buffer, size_t size) {
+            size_t bytes = std::min(size, head.size());
+            memcpy(buffer, head.data(), bytes);
+            head.erase(0, bytes);
+
+            return bytes + fread(buffer + bytes, 1, size - bytes, file);
+        }
+
+        bool failed() const { return ferror(file); }
+};
+
+// uncompressed file, or a pipe
+class FileSource : public ByteSource {
+    private:
+        unique_ptr<FileInput> file;
+
+    public:
+        FileSource(unique_ptr<FileInput> input) : file(move(input)) {}
+
+        size_t read(char* buffer, size_t size) override {
+            size_t bytes = file->read(buffer, size);
+            error = error || file->failed();
+
+            return bytes;
+        }
+};
+
+// gzip members (one after another, as written by gzip -c a b or pigz), or the raw deflate data of a zip entry
+class InflateSource : public ByteSource {
+    private:
+        unique_ptr<FileInput> file;
+        z_stream stream;
+        vector<char> input;
+        bool concatenated; // more members may follow the end of one
+        bool member_ended = false; // the last inflate ended a member, so the file may end cleanly
+        bool done = false;
+
+    public:
+        /**
+         * Constructor for InflateSource
+         * @param compressed: input positioned at the start of the compressed data
+         * @param window_bits: 15 + 32 for gzip, -15 for raw deflate
+         * @param members: whether members can follow each other
+        */
+        InflateSource(unique_ptr<FileInput> compressed, int window_bits, bool members) :
+            file(move(compressed)), input(INPUT_CHUNK), concatenated(members) {
+            memset(&stream, 0, sizeof(stream));
+            error = inflateInit2(&stream, window_bits) != Z_OK;
+            done = error;
+        }
+
+        ~InflateSource() {
+            inflateEnd(&stream);
+        }
+
+        size_t read(char* buffer, size_t size) override {
+            stream.next_out = (Bytef*) buffer;
+            stream.avail_out = size;
+
+            while (stream.avail_out > 0 && !done) {
+                if (stream.avail_in == 0) {
+                    stream.avail_in = file->read(input.data(), input.size());
+                    stream.next_in = (Bytef*) input.data();
+
+                    if (stream.avail_in == 0) {
+                        error = !member_ended; // the file ended in the middle of a member
+                        done = true;
+                        break;
+                    }
+                }
+
+                int status = inflate(&stream, Z_NO_FLUSH);
+
+                if (status == Z_STREAM_END) {
+                    member_ended = true;
+                    done = !concatenated;
+                    inflateReset(&stream);
+                }
+                else if (status == Z_OK || status == Z_BUF_ERROR) {
+                    member_ended = false;
+                }
+                else {
+                    // anything after the last member that isn't another member is padding, gzip ignores it too
+                    error = !member_ended;
+                    done = true;
+                }
+            }
+
+            return size - stream.avail_out;
+        }
+};
+
+// bzip2 streams read one after another from a file or a pipe
+class Bz2Source : public ByteSource {
+    private:
+        unique_ptr<FileInput> file;
+        bz_stream stream;
+        vector<char> input;
+        bool stream_ended = false; // the last decompress ended a stream, so the file may end cleanly
+        bool done = false;
+
+    public:
+        Bz2Source(unique_ptr<FileInput> compressed) : file(move(compressed)), input(INPUT_CHUNK) {
+            memset(&stream, 0, sizeof(stream));
+            error = BZ2_bzDecompressInit(&stream, 0, 0) != BZ_OK;
+            done = error;
+        }
+
+        ~Bz2Source() {
+            BZ2_bzDecompressEnd(&stream);
+        }
+
+        size_t read(char* buffer, size_t size) override {
+            stream.next_out = buffer;
+            stream.avail_out = size;
+
+            while (stream.avail_out > 0 && !done) {
+                if (stream.avail_in == 0) {
+                    stream.avail_in = file->read(input.data(), input.size());
+                    stream.next_in = input.data();
+
+                    if (stream.avail_in == 0) {
+                        error = !stream_ended;
+                        done = true;
+                        break;
+                    }
+                }
+
+                int status = BZ2_bzDecompress(&stream);
+
+                if (status == BZ_STREAM_END) {
+                    // start over for the next stream, the unread input stays where it is
+                    char* next_in = stream.next_in;
+                    unsigned int avail_in = stream.avail_in;
+                    BZ2_bzDecompressEnd(&stream);
+                    BZ2_bzDecompressInit(&stream, 0, 0);
+                    stream.next_in = next_in;
+                    stream.avail_in = avail_in;
+                    stream_ended = true;
+                }
+                else if (status == BZ_OK) {
+                    stream_ended = false;
+                }
+                else {
+                    error = !stream_ended;
+                    done = true;
+                }
+            }
+
+            return size - (size_t) stream.avail_out;
+        }
+};
+
+/**
+ * Decompresses bzip2 streams that sit one after another in memory
+ * @param compressed: the streams
+ * @param output: appended to
+ * @return false if the data is corrupt or ends in the middle of a stream
+*/
+bool decompress_bz2(string_view compressed, string& output) {
+    size_t pos = 0;
+    char buffer[64 * 1024];
+
+    while (pos < compressed.size()) {
+        bz_stream stream;
+        memset(&stream, 0, sizeof(stream));
+
+        if (BZ2_bzDecompressInit(&stream, 0, 0) != BZ_OK) {
+            return false;
+        }
+
+        stream.next_in = const_cast<char*>(compressed.data() + pos);
+        stream.avail_in = compressed.size() - pos;
+        int status = BZ_OK;
+
+        while (status == BZ_OK) {
+            stream.next_out = buffer;
+            stream.avail_out = sizeof(buffer);
+            status = BZ2_bzDecompress(&stream);
+            output.append(buffer, sizeof(buffer) - stream.avail_out);
+
+            if (status == BZ_OK && stream.avail_in == 0 && stream.avail_out > 0) {
+                status = BZ_UNEXPECTED_EOF; // out of input in the middle of a stream
+            }
+        }
+
+        pos = compressed.size() - stream.avail_in;
+        BZ2_bzDecompressEnd(&stream);
+
+        if (status != BZ_STREAM_END) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Finds where the bzip2 streams of a file start: "BZh", the block size, then the magic of either
+ * a block or the end of an empty stream. Streams are byte aligned, so a multistream file can be
+ * cut at every one of them
+ * @param data: the whole file
+ * @return offsets of the streams, starting with 0
+*/
+vector<size_t> find_bz2_streams(string_view data) {
+    vector<size_t> starts = {0};
+    string_view block_magic("\x31\x41\x59\x26\x53\x59", 6);
+    string_view end_magic("\x17\x72\x45\x38\x50\x90", 6);
+
+    for (size_t pos = data.find("BZh", 1); pos != string_view::npos; pos = data.find("BZh", pos + 1)) {
+        if (pos + 10 <= data.size() && data[pos + 3] >= '1' && data[pos + 3] <= '9'
+                && (data.substr(pos + 4, 6) == block_magic || data.substr(pos + 4, 6) == end_magic)) {
+            starts.push_back(pos);
+        }
+    }
+
+    return starts;
+}
+
+// multistream bzip2 file, its streams decompressed a segment at a time by several threads and read in order
+class ParallelBz2Source : public ByteSource {
+    private:
+        unique_ptr<MappedFile> file;
+        vector<string_view> segments; // compressed, each one or more whole streams
+        vector<string> outputs; // segment -> decompressed bytes, freed once read
+        vector<char> ready; // segment -> 0 until decompressed, then 1, or 2 if it is corrupt
+        vector<thread> workers;
+        mutex lock; // guards everything below and outputs/ready
+        condition_variable segment_ready; // signalled when a segment is decompressed
+        condition_variable segment_read; // signalled when the reader moves on to the next segment
+        size_t next_segment = 0; // first segment no worker has taken
+        size_t curr_segment = 0; // segment being read
+        size_t offset = 0; // bytes of the current segment already read
+        size_t lookahead; // most segments decompressed ahead of the reader, bounds memory
+        bool stopping = false;
+
+        void work() {
+            unique_lock<mutex> guard(lock);
+
+            while (true) {
+                segment_read.wait(guard, [this]() {
+                    return stopping || next_segment >= segments.size() || next_segment < curr_segment + lookahead;
+                });
+
+                if (stopping || next_segment >= segments.size()) {
+                    return;
+                }
+
+                size_t segment = next_segment++;
+                guard.unlock();
+                string output;
+                bool ok = decompress_bz2(segments[segment], output);
+                guard.lock();
+
+                outputs[segment] = std::move(output);
+                ready[segment] = ok ? 1 : 2;
+                segment_ready.notify_all();
+            }
+        }
+
+    public:
+        ParallelBz2Source(unique_ptr<MappedFile> mapped, const vector<size_t>& starts, int threads) :
+            file(std::move(mapped)), lookahead(2 * threads) {
+            string_view data = file->view();
+            size_t begin = 0;
+
+            // group streams into segments big enough to be worth a task
+            for (size_t i = 1; i <= starts.size(); i++) {
+                size_t end = i < starts.size() ? starts[i] : data.size();
+
+                if (end - begin >= MIN_SEGMENT || i == starts.size()) {
+                    segments.push_back(data.substr(begin, end - begin));
+                    begin = end;
+                }
+            }
+
+            outputs.resize(segments.size());
+            ready.resize(segments.size(), 0);
+
+            for (int i = 0; i < threads; i++) {
+                workers.emplace_back(&ParallelBz2Source::work, this);
+            }
+        }
+
+        ~ParallelBz2Source() {
+            {
+                unique_lock<mutex> guard(lock);
+                stopping = true;
+            }
+
+            segment_read.notify_all();
+
+            for (thread& worker: workers) {
+                worker.join();
+            }
+        }
+
+        int thread_count() const override {
+            return workers.size();
+        }
+
+        size_t read(char* buffer, size_t size) override {
+            unique_lock<mutex> guard(lock);
+            size_t bytes = 0;
+
+            while (bytes < size && curr_segment < segments.size() && !error) {
+                segment_ready.wait(guard, [this]() { return ready[curr_segment] != 0; });
+
+                if (ready[curr_segment] == 2) {
+                    error = true; // everything before the corrupt segment has still been read
+                    break;
+                }
+
+                const string& output = outputs[curr_segment];
+                size_t count = std::min(size - bytes, output.size() - offset);
+                memcpy(buffer + bytes, output.data() + offset, count);
+                bytes += count;
+                offset += count;
+
+                if (offset == output.size()) {
+                    string().swap(outputs[curr_segment]); // read, free it
+                    curr_segment++;
+                    offset = 0;
+                    segment_read.notify_all();
+                }
+            }
+
+            return bytes;
+        }
+};
+
+#ifdef HAVE_ZSTD
+// zstd frames, one after another
+class ZstdSource : public ByteSource {
+    private:
+        unique_ptr<FileInput> file;
+        ZSTD_DStream* stream;
+        vector<char> input;
+        ZSTD_inBuffer in = {nullptr, 0, 0};
+        bool frame_ended = true; // nothing has been started, or the last call ended a frame
+        bool done = false;
+
+    public:
+        ZstdSource(unique_ptr<FileInput> compressed) : file(move(compressed)), stream(ZSTD_createDStream()), input(ZSTD_DStreamInSize()) {
+            error = !stream || ZSTD_isError(ZSTD_initDStream(stream));
+            done = error;
+        }
+
+        ~ZstdSource() {
+            ZSTD_freeDStream(stream);
+        }
+
+        size_t read(char* buffer, size_t size) override {
+            ZSTD_outBuffer out = {buffer, size, 0};
+
+            while (out.pos < out.size && !done) {
+                if (in.pos == in.size) {
+                    in.size = file->read(input.data(), input.size());
+                    in.src = input.data();
+                    in.pos = 0;
+
+                    if (in.size == 0) {
+                        error = !frame_ended;
+                        done = true;
+                        break;
+                    }
+                }
+
+                size_t status = ZSTD_decompressStream(stream, &out, &in);
+
+                if (ZSTD_isError(status)) {
+                    error = true;
+                    done = true;
+                }
+                else {
+                    frame_ended = status == 0;
+                }
+            }
+
+            return out.pos;
+        }
+};
+#endif
+
+/**
+ * Opens a corpus for streaming, decompressing it if its first bytes say it is compressed. Multistream
+ * bzip2 files are decompressed by several threads; gzip, zip and zstd are decompressed by one, as their
+ * streams can't be split without decompressing them first
+ * @param path: path of the corpus, a file or a pipe
+ * @param threads: threads for formats that can be decompressed in parallel
+ * @return source of the uncompressed corpus, nullptr if it can't be opened or its format isn't supported
+*/
+unique_ptr<ByteSource> open_source(const string& path, int threads) {
+    FILE* file = fopen(path.c_str(), "rb");
+    char head[30];
+
+    if (!file) {
+        return nullptr;
+    }
+
+    size_t head_size = fread(head, 1, sizeof(head), file);
+    CorpusFormat format = detect_format(string_view(head, head_size));
+
+    if (format == BZIP2 && threads > 1) {
+        unique_ptr<MappedFile> mapped(new MappedFile(path));
+
+        if (mapped->is_open()) {
+            vector<size_t> starts = find_bz2_streams(mapped->view());
+
+            if (starts.size() > 1) {
+                fclose(file);
+                return unique_ptr<ByteSource>(new ParallelBz2Source(move(mapped), starts, threads));
+            }
+        }
+    }
+
+    unique_ptr<FileInput> input(new FileInput(file, string(head, head_size)));
+
+    switch (format) {
+        case GZIP:
+            return unique_ptr<ByteSource>(new InflateSource(move(input), MAX_WBITS + 32, true));
+        case BZIP2:
+            return unique_ptr<ByteSource>(new Bz2Source(move(input)));
+        case ZSTD:
+#ifdef HAVE_ZSTD
+            return unique_ptr<ByteSource>(new ZstdSource(move(input)));
+#else
+            return nullptr; // built without zstd, "make ZSTD=1"
+#endif
+        case ZIP: {
+            // local file header: method at 8, name and extra field lengths at 26 and 28, then the data
+            if (head_size < 30) {
+                return nullptr; // too short to hold the header
+            }
+
+            const unsigned char* header = (const unsigned char*) head;
+            int method = header[8] | header[9] << 8;
+            size_t skip = 30 + (header[26] | header[27] << 8) + (header[28] | header[29] << 8);
+            vector<char> skipped(skip);
+
+            if (method != Z_DEFLATED || input->read(skipped.data(), skip) != skip) {
+                return nullptr; // only deflated entries
+            }
+
+            return unique_ptr<ByteSource>(new InflateSource(move(input), -MAX_WBITS, false));
+        }
+        default:
+            return unique_ptr<ByteSource>(new FileSource(move(input)));
+    }
+}
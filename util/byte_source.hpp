@@ -0,0 +1,54 @@
+#ifndef BYTE_SOURCE_H
+#define BYTE_SOURCE_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <cstdio>
+using std::string;
+using std::string_view;
+using std::unique_ptr;
+
+// formats a corpus can come in, told apart by their first bytes
+enum CorpusFormat {
+    PLAIN, // uncompressed xml
+    GZIP, // one or more gzip members
+    BZIP2, // one or more bzip2 streams, like wikipedia's multistream dumps
+    ZSTD, // one or more zstd frames, only readable when built with ZSTD=1
+    ZIP // the first entry of a zip archive
+};
+
+CorpusFormat detect_format(string_view head);
+
+// stream of bytes a corpus is read from, decompressing on the fly if need be
+class ByteSource {
+    protected:
+        bool error = false; // read failed or the data is corrupt
+
+    public:
+        virtual ~ByteSource() = default;
+
+        /**
+         * Reads the next bytes of the stream
+         * @param buffer: where to put them
+         * @param size: most bytes to read
+         * @return bytes read, 0 at the end of the stream or on failure
+        */
+        virtual size_t read(char* buffer, size_t size) = 0;
+
+        /**
+         * Whether the stream ended because of an error rather than running out
+         * @return true if reading failed
+        */
+        bool failed() const { return error; }
+
+        /**
+         * Threads of its own the stream is decompressed on, besides the one reading it
+         * @return threads, 0 if it is decompressed as it is read
+        */
+        virtual int thread_count() const { return 0; }
+};
+
+unique_ptr<ByteSource> open_source(const string& path, int threads = 1);
+
+#endif // BYTE_SOURCE_H
@@ -0,0 +1,352 @@
+#include "doc_cursor.hpp"
+#include <algorithm>
+using std::sort;
+using std::lower_bound;
+using std::push_heap;
+using std::pop_heap;
+using std::min;
+
+/**
+ * Constructor for PostingsCursor over postings that outlive it
+ * @param list: postings of a term
+*/
+PostingsCursor::PostingsCursor(const PostingList& list) : postings(list) {
+    load(0);
+}
+
+/**
+ * Constructor for PostingsCursor over a copy of a list
+ * @param list: (dense doc id, score) sorted by doc, like the matches of a phrase
+*/
+PostingsCursor::PostingsCursor(const vector<pair<int, double>>& list) {
+    for (const auto& match: list) {
+        owned_docs.push_back(match.first);
+        owned_scores.push_back(match.second);
+    }
+
+    postings.docs = owned_docs.data();
+    postings.scores = owned_scores.data();
+    postings.size = list.size();
+    load(0);
+}
+
+/**
+ * Decodes a block, if the list has it
+ * @param next_block: block number
+*/
+void PostingsCursor::load(size_t next_block) {
+    if (next_block < postings.num_blocks()) {
+        block = next_block;
+        block_size = postings.decode_block(block, block_docs);
+    }
+}
+
+int PostingsCursor::doc() const {
+    return index < postings.size ? block_docs[index - block * POSTING_BLOCK] : END;
+}
+
+double PostingsCursor::score() const {
+    return postings.score(index);
+}
+
+void PostingsCursor::next() {
+    index++;
+
+    if (index == (block + 1) * POSTING_BLOCK) {
+        load(block + 1);
+    }
+}
+
+/**
+ * Gallops to a target over the first docs of the blocks, which are kept as is: doubles the step until
+ * it overshoots, then binary searches the last step, so a seek costs the log of how far it goes rather
+ * than the log of the whole list, and decodes only the block the target is in
+ * @param target: dense doc id to move to
+*/
+void PostingsCursor::seek(int target) {
+    if (doc() >= target) {
+        return; // there already, or exhausted
+    }
+
+    if (block_docs[block_size - 1] < target) {
+        size_t count = postings.num_blocks();
+        size_t low = block; // always starts before the target
+        size_t step = 1;
+
+        while (low + step < count && postings.first_doc(low + step) <= target) {
+            low += step;
+            step *= 2;
+        }
+
+        size_t high = min(low + step, count); // starts after the target, or past the last block
+
+        while (high - low > 1) {
+            size_t middle = low + (high - low) / 2;
+
+            if (postings.first_doc(middle) <= target) {
+                low = middle;
+            }
+            else {
+                high = middle;
+            }
+        }
+
+        if (low != block) {
+            load(low);
+            index = low * POSTING_BLOCK;
+        }
+    }
+
+    // the target is in this block or starts the next one
+    const int* found = lower_bound(block_docs + (index - block * POSTING_BLOCK), block_docs + block_size, target);
+    index = block * POSTING_BLOCK + (found - block_docs);
+
+    if (index == (block + 1) * POSTING_BLOCK) {
+        load(block + 1);
+    }
+}
+
+long PostingsCursor::cost() const {
+    return postings.size;
+}
+
+/**
+ * Constructor for AllDocsCursor
+ * @param docs: number of documents in the corpus
+*/
+AllDocsCursor::AllDocsCursor(int docs) : num_docs(docs) {}
+
+int AllDocsCursor::doc() const {
+    return current < num_docs ? current : END;
+}
+
+double AllDocsCursor::score() const {
+    return 0;
+}
+
+void AllDocsCursor::next() {
+    current++;
+}
+
+void AllDocsCursor::seek(int target) {
+    current = std::max(current, target);
+}
+
+long AllDocsCursor::cost() const {
+    return num_docs;
+}
+
+/**
+ * Constructor for AndCursor
+ * @param cursors: cursors to intersect, at least one
+*/
+AndCursor::AndCursor(vector<unique_ptr<DocCursor>> cursors) : children(std::move(cursors)) {
+    sort(children.begin(), children.end(), [](const unique_ptr<DocCursor>& a, const unique_ptr<DocCursor>& b) {
+        return a->cost() < b->cost();
+    });
+    align();
+}
+
+/**
+ * Moves the children until they are all on the same doc: whoever is furthest along leads, and
+ * the others seek to it until a whole round agrees
+*/
+void AndCursor::align() {
+    int target = children[0]->doc();
+    size_t agreed = 1; // children on the target, counting the leader
+    size_t i = 1 % children.size();
+
+    while (target != END && agreed < children.size()) {
+        children[i]->seek(target);
+
+        if (children[i]->doc() == target) {
+            agreed++;
+        }
+        else {
+            target = children[i]->doc(); // overshot, this child leads now
+            agreed = 1;
+        }
+
+        i = (i + 1) % children.size();
+    }
+
+    current = target;
+}
+
+int AndCursor::doc() const {
+    return current;
+}
+
+double AndCursor::score() const {
+    double total = 0;
+
+    for (const auto& child: children) {
+        total += child->score();
+    }
+
+    return total;
+}
+
+void AndCursor::next() {
+    children[0]->next();
+    align();
+}
+
+void AndCursor::seek(int target) {
+    if (current < target) {
+        children[0]->seek(target);
+        align();
+    }
+}
+
+long AndCursor::cost() const {
+    return children[0]->cost();
+}
+
+/**
+ * Constructor for OrCursor
+ * @param cursors: cursors to merge
+*/
+OrCursor::OrCursor(vector<unique_ptr<DocCursor>> cursors) : children(std::move(cursors)) {
+    for (int i = 0; i < (int) children.size(); i++) {
+        matched.push_back(i);
+    }
+
+    seek(0);
+}
+
+/**
+ * Orders the heap, children on nearer docs come out first
+ * @param a: index of a child
+ * @param b: index of another child
+ * @return whether a is on a later doc than b
+*/
+bool OrCursor::later(int a, int b) const {
+    return children[a]->doc() > children[b]->doc();
+}
+
+/**
+ * Puts a child back on the heap, unless it is exhausted
+ * @param child: index of the child
+*/
+void OrCursor::push_child(int child) {
+    if (children[child]->doc() != END) {
+        heap.push_back(child);
+        push_heap(heap.begin(), heap.end(), [this](int a, int b) { return later(a, b); });
+    }
+}
+
+/**
+ * Takes the child on the nearest doc off the heap
+ * @return index of the child
+*/
+int OrCursor::pop_child() {
+    pop_heap(heap.begin(), heap.end(), [this](int a, int b) { return later(a, b); });
+    int child = heap.back();
+    heap.pop_back();
+
+    return child;
+}
+
+/**
+ * Pops every child on the nearest doc off the heap, making it the current doc
+*/
+void OrCursor::settle() {
+    current = heap.empty() ? END : children[heap.front()]->doc();
+    current_score = 0;
+
+    while (!heap.empty() && children[heap.front()]->doc() == current) {
+        int child = pop_child();
+        matched.push_back(child);
+        current_score += children[child]->score();
+    }
+}
+
+int OrCursor::doc() const {
+    return current;
+}
+
+double OrCursor::score() const {
+    return current_score;
+}
+
+void OrCursor::next() {
+    for (int i: matched) {
+        children[i]->next();
+        push_child(i);
+    }
+
+    matched.clear();
+    settle();
+}
+
+void OrCursor::seek(int target) {
+    // children behind the target come off the heap too, they get pushed back once moved
+    while (!heap.empty() && children[heap.front()]->doc() < target) {
+        matched.push_back(pop_child());
+    }
+
+    for (int i: matched) {
+        children[i]->seek(target);
+        push_child(i);
+    }
+
+    matched.clear();
+    settle();
+}
+
+long OrCursor::cost() const {
+    long total = 0;
+
+    for (const auto& child: children) {
+        total += child->cost();
+    }
+
+    return total;
+}
+
+/**
+ * Constructor for AndNotCursor
+ * @param included: cursor whose documents are kept
+ * @param excluded: cursor whose documents are taken out
+*/
+AndNotCursor::AndNotCursor(unique_ptr<DocCursor> included, unique_ptr<DocCursor> excluded) : include(std::move(included)), exclude(std::move(excluded)) {
+    skip_excluded();
+}
+
+/**
+ * Moves past the documents the excluded cursor matches
+*/
+void AndNotCursor::skip_excluded() {
+    while (include->doc() != END) {
+        exclude->seek(include->doc());
+
+        if (exclude->doc() != include->doc()) {
+            break;
+        }
+
+        include->next();
+    }
+}
+
+int AndNotCursor::doc() const {
+    return include->doc();
+}
+
+double AndNotCursor::score() const {
+    return include->score();
+}
+
+void AndNotCursor::next() {
+    include->next();
+    skip_excluded();
+}
+
+void AndNotCursor::seek(int target) {
+    include->seek(target);
+    skip_excluded();
+}
+
+long AndNotCursor::cost() const {
+    return include->cost();
+}
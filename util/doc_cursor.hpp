@@ -0,0 +1,152 @@
+#ifndef DOC_CURSOR_H
+#define DOC_CURSOR_H
+
+#include <vector>
+#include <memory>
+#include <climits>
+#include "util/postings.hpp"
+using std::vector;
+using std::pair;
+using std::unique_ptr;
+
+// walks the documents matching (part of) a query in ascending doc id order, only ever moving forward
+class DocCursor {
+    public:
+        static const int END = INT_MAX; // doc of an exhausted cursor
+
+        virtual ~DocCursor() = default;
+
+        /**
+         * Current document
+         * @return dense doc id, END once there are no more
+        */
+        virtual int doc() const = 0;
+
+        /**
+         * Score of the current document, summed over the terms that matched it
+         * @return score, 0 for documents only matched by negation
+        */
+        virtual double score() const = 0;
+
+        /**
+         * Moves to the next document
+        */
+        virtual void next() = 0;
+
+        /**
+         * Moves to the first document at or after a target, staying put if already there
+         * @param target: dense doc id to move to
+        */
+        virtual void seek(int target) = 0;
+
+        /**
+         * Most documents the cursor can match, to intersect the rarest cursors first
+         * @return upper bound on the number of matches
+        */
+        virtual long cost() const = 0;
+};
+
+// documents of a postings list, or of any (doc, score) list sorted by doc, decoded a block at a time
+class PostingsCursor : public DocCursor {
+    private:
+        vector<int> owned_docs; // matches computed for this cursor, if it isn't over postings
+        vector<double> owned_scores;
+        PostingList postings;
+        int block_docs[POSTING_BLOCK]; // doc ids of the current block
+        size_t block = 0; // current block
+        size_t block_size = 0; // postings in it
+        size_t index = 0; // current posting, from the start of the list
+
+        void load(size_t next_block);
+
+    public:
+        PostingsCursor(const PostingList& list);
+        PostingsCursor(const vector<pair<int, double>>& list);
+        PostingsCursor(const PostingsCursor&) = delete;
+        PostingsCursor& operator=(const PostingsCursor&) = delete;
+        PostingsCursor(PostingsCursor&&) = default; // the owned vectors keep their buffers
+
+        int doc() const override;
+        double score() const override;
+        void next() override;
+        void seek(int target) override;
+        long cost() const override;
+};
+
+// every document, what a negation is taken out of when nothing else narrows it down
+class AllDocsCursor : public DocCursor {
+    private:
+        int current = 0;
+        int num_docs;
+
+    public:
+        AllDocsCursor(int docs);
+
+        int doc() const override;
+        double score() const override;
+        void next() override;
+        void seek(int target) override;
+        long cost() const override;
+};
+
+// documents matched by every child, leapfrogging each child to the furthest doc any child is on
+class AndCursor : public DocCursor {
+    private:
+        vector<unique_ptr<DocCursor>> children; // rarest first
+        int current;
+
+        void align();
+
+    public:
+        AndCursor(vector<unique_ptr<DocCursor>> cursors);
+
+        int doc() const override;
+        double score() const override;
+        void next() override;
+        void seek(int target) override;
+        long cost() const override;
+};
+
+// documents matched by any child, merged with a heap on the children's docs
+class OrCursor : public DocCursor {
+    private:
+        vector<unique_ptr<DocCursor>> children;
+        vector<int> heap; // children not on the current doc, nearest doc on top
+        vector<int> matched; // children on the current doc
+        int current;
+        double current_score;
+
+        bool later(int a, int b) const;
+        void push_child(int child);
+        int pop_child();
+        void settle();
+
+    public:
+        OrCursor(vector<unique_ptr<DocCursor>> cursors);
+
+        int doc() const override;
+        double score() const override;
+        void next() override;
+        void seek(int target) override;
+        long cost() const override;
+};
+
+// documents matched by one cursor but not by another, which is only ever skipped forward
+class AndNotCursor : public DocCursor {
+    private:
+        unique_ptr<DocCursor> include;
+        unique_ptr<DocCursor> exclude;
+
+        void skip_excluded();
+
+    public:
+        AndNotCursor(unique_ptr<DocCursor> included, unique_ptr<DocCursor> excluded);
+
+        int doc() const override;
+        double score() const override;
+        void next() override;
+        void seek(int target) override;
+        long cost() const override;
+};
+
+#endif // DOC_CURSOR_H
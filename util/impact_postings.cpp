@@ -0,0 +1,167 @@
+#include "impact_postings.hpp"
+#include "varint.hpp"
+#include <algorithm>
+#include <cstring>
+using std::sort;
+using std::pair;
+using std::min;
+using std::max;
+
+/**
+ * Decodes the first doc ids of the segment
+ * @param out: where to put them, room for n
+ * @param n: doc ids to decode, at most the segment's size
+ * @return number of doc ids decoded
+*/
+size_t ImpactSegment::decode(int* out, size_t n) const {
+    n = min(n, size);
+
+    if (n == 0) {
+        return 0;
+    }
+
+    size_t offset = 0;
+    int doc = get_varint(gaps, offset);
+    out[0] = doc;
+    int width = (unsigned char) gaps[offset++];
+    const char* packed = gaps + offset;
+    uint64_t mask = (1ULL << width) - 1;
+    size_t bit = 0;
+
+    // a gap is at most 32 bits from a byte boundary plus 7, so one unaligned 8 byte load holds it
+    for (size_t i = 1; i < n; i++) {
+        uint64_t word;
+        memcpy(&word, packed + (bit >> 3), sizeof(word));
+        doc += (word >> (bit & 7)) & mask;
+        bit += width;
+        out[i] = doc;
+    }
+
+    return n;
+}
+
+/**
+ * Makes room for the impact ordered postings of every term, replacing what was there, so terms can
+ * then be filled in any order and from any thread
+ * @param postings: quantized postings, doc ordered
+*/
+void ImpactPostings::allocate(const Postings& postings) {
+    bytes.clear();
+    segments.clear();
+    byte_offsets.clear();
+    segment_offsets.clear();
+    pending.assign(postings.num_terms(), {});
+}
+
+/**
+ * Sorts the postings of a term by descending impact, splits them into segments and encodes each. Their
+ * size is only known once encoded, so they are packed by finish
+ * @param term_id: term id
+ * @param list: quantized postings of the term
+*/
+void ImpactPostings::fill(int term_id, const PostingList& list) {
+    vector<pair<int, int>> order(list.size); // (impact, dense doc id)
+    int block_docs[POSTING_BLOCK];
+
+    for (size_t block = 0; block < list.num_blocks(); block++) {
+        size_t start = block * POSTING_BLOCK;
+        size_t n = list.decode_block(block, block_docs);
+
+        for (size_t i = 0; i < n; i++) {
+            order[start + i] = {list.impact(start + i), block_docs[i]};
+        }
+    }
+
+    // doc ids are distinct, so this is the doc order within each impact
+    sort(order.begin(), order.end(), [](const pair<int, int>& a, const pair<int, int>& b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    });
+
+    PendingTerm& term = pending[term_id];
+
+    for (size_t i = 0, end; i < order.size(); i = end) {
+        uint32_t max_gap = 0;
+
+        for (end = i + 1; end < order.size() && order[end].first == order[i].first; end++) {
+            max_gap = max(max_gap, (uint32_t) (order[end].second - order[end - 1].second));
+        }
+
+        term.segments.push_back({order[i].first, (uint32_t) term.bytes.size()});
+        put_varint(term.bytes, (uint32_t) (end - i));
+        put_varint(term.bytes, order[i].second);
+        int width = max_gap == 0 ? 0 : 32 - __builtin_clz(max_gap);
+        term.bytes += (char) width;
+        uint64_t bits = 0; // packed but not yet written
+        int num_bits = 0;
+
+        for (size_t j = i + 1; j < end; j++) {
+            bits |= (uint64_t) (order[j].second - order[j - 1].second) << num_bits;
+
+            for (num_bits += width; num_bits >= 8; num_bits -= 8) {
+                term.bytes += (char) bits;
+                bits >>= 8;
+            }
+        }
+
+        if (num_bits > 0) {
+            term.bytes += (char) bits;
+        }
+    }
+}
+
+/**
+ * Packs the segments and their encodings of every term into flat arrays, once every term has been filled
+*/
+void ImpactPostings::finish() {
+    byte_offsets.assign(1, 0);
+    segment_offsets.assign(1, 0);
+
+    for (const PendingTerm& term: pending) {
+        byte_offsets.push_back(byte_offsets.back() + term.bytes.size());
+        segment_offsets.push_back(segment_offsets.back() + term.segments.size());
+    }
+
+    bytes.reserve(byte_offsets.back() + sizeof(uint64_t));
+    segments.reserve(segment_offsets.back());
+
+    for (PendingTerm& term: pending) {
+        bytes.insert(bytes.end(), term.bytes.begin(), term.bytes.end());
+        segments.insert(segments.end(), term.segments.begin(), term.segments.end());
+        term = PendingTerm(); // frees it as it goes
+    }
+
+    bytes.resize(bytes.size() + sizeof(uint64_t), 0); // so decoding the last gap can load 8 bytes
+
+    vector<PendingTerm>().swap(pending);
+}
+
+/**
+ * Number of segments of a term, one per distinct impact
+ * @param term_id: term id
+ * @return segments
+*/
+int ImpactPostings::num_segments(int term_id) const {
+    return segment_offsets[term_id + 1] - segment_offsets[term_id];
+}
+
+/**
+ * Segment of a term
+ * @param term_id: term id
+ * @param i: segment number, segments of higher impacts first
+ * @return view of the segment, valid as long as the postings aren't laid out again
+*/
+ImpactSegment ImpactPostings::segment(int term_id, int i) const {
+    const Segment& segment = segments[segment_offsets[term_id] + i];
+    size_t offset = byte_offsets[term_id] + segment.start;
+    size_t size = get_varint(bytes.data(), offset);
+
+    return {segment.impact, size, bytes.data() + offset};
+}
+
+/**
+ * Memory taken by the impact ordered postings
+ * @return bytes of the encoded segments, segments and offsets
+*/
+size_t ImpactPostings::memory_bytes() const {
+    return bytes.capacity() + segments.capacity() * sizeof(Segment) + (byte_offsets.capacity() + segment_offsets.capacity()) * sizeof(size_t);
+}
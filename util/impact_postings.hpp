@@ -0,0 +1,57 @@
+#ifndef IMPACT_POSTINGS_H
+#define IMPACT_POSTINGS_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "util/postings.hpp"
+using std::vector;
+using std::string;
+
+// postings of one term that share an impact, what a score-at-a-time query processes in one go
+struct ImpactSegment {
+    int impact;
+    size_t size; // postings
+    const char* gaps; // its dense doc ids, ascending, encoded
+
+    size_t decode(int* out, size_t n) const;
+};
+
+// postings of every term sorted by descending impact and split into segments of equal impact, so a
+// query can process the postings that add the most to scores first and stop whenever it likes.
+// A second copy of the doc ids next to the doc ordered postings, which cursors still need. Most
+// segments hold a few postings, too few for blocks like the doc ordered ones, so each is encoded on
+// its own: a varint of its size and one of its first doc id, then the gaps between its doc ids packed
+// in as many bits as the largest one takes, which decodes without a branch per gap. Gaps within a
+// segment are wide, so this is as small as varints: 8 bytes a segment plus about 2 bytes a posting
+class ImpactPostings {
+    private:
+        struct Segment {
+            int impact;
+            uint32_t start; // first byte of its encoding, from the start of the term's
+        };
+
+        // encoded postings of a term, between fill and finish
+        struct PendingTerm {
+            vector<Segment> segments;
+            string bytes;
+        };
+
+        vector<size_t> byte_offsets; // term ids -> first byte of their segments, with the end of the last term's at the back
+        vector<size_t> segment_offsets; // term ids -> first segment, the same way
+        vector<char> bytes; // encoded segments, by term then segment, with 8 bytes of padding at the end
+        vector<Segment> segments;
+        vector<PendingTerm> pending; // term ids -> encoded postings, between allocate and finish
+
+    public:
+        void allocate(const Postings& postings);
+        void fill(int term_id, const PostingList& list);
+        void finish();
+
+        int num_segments(int term_id) const;
+        ImpactSegment segment(int term_id, int i) const;
+        size_t memory_bytes() const;
+};
+
+#endif // IMPACT_POSTINGS_H
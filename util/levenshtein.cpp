@@ -0,0 +1,137 @@
+#include "levenshtein.hpp"
+#include <algorithm>
+using std::min;
+
+/**
+ * Constructor for LevenshteinAutomaton
+ * @param target: word to match strings against
+ * @param edits: most edits a matching string can be away from the word
+*/
+LevenshteinAutomaton::LevenshteinAutomaton(string_view target, int edits) : word(target), max_edits(edits) {}
+
+/**
+ * Sets a state to the start state, nothing read yet
+ * @param state: state to set
+*/
+void LevenshteinAutomaton::start(vector<int>& state) const {
+    state.resize(word.size() + 1);
+
+    for (int i = 0; i <= (int) word.size(); i++) {
+        state[i] = min(i, max_edits + 1); // the first i characters of the word, all deleted
+    }
+}
+
+/**
+ * Reads one more character
+ * @param state: state before the character
+ * @param c: character read
+ * @param next: set to the state after the character
+*/
+void LevenshteinAutomaton::step(const vector<int>& state, char c, vector<int>& next) const {
+    next.resize(word.size() + 1);
+    next[0] = min(state[0] + 1, max_edits + 1); // c inserted
+
+    for (int i = 1; i <= (int) word.size(); i++) {
+        int substituted = state[i - 1] + (word[i - 1] != c);
+        int inserted = state[i] + 1;
+        int deleted = next[i - 1] + 1;
+        next[i] = min(min(substituted, inserted), min(deleted, max_edits + 1));
+    }
+}
+
+/**
+ * Whether any string starting with what was read can still match
+ * @param state: current state
+ * @return false once every entry of the row is over the edit budget, the state is dead
+*/
+bool LevenshteinAutomaton::can_match(const vector<int>& state) const {
+    return *std::min_element(state.begin(), state.end()) <= max_edits;
+}
+
+/**
+ * Whether what was read is within the edit budget of the word
+ * @param state: current state
+ * @return true if the string read so far matches
+*/
+bool LevenshteinAutomaton::is_match(const vector<int>& state) const {
+    return state.back() <= max_edits;
+}
+
+/**
+ * Edit distance between what was read and the word
+ * @param state: current state
+ * @return distance, more than max_edits if it doesn't match
+*/
+int LevenshteinAutomaton::distance(const vector<int>& state) const {
+    return state.back();
+}
+
+/**
+ * Finds the terms of a dictionary an automaton accepts by walking the dictionary in sorted order as
+ * if it were a trie: terms share the automaton states of the prefix they have in common with the
+ * term before them, and as soon as a prefix leads to a dead state the walk seeks past every term
+ * starting with it, so only terms with live prefixes are ever looked at
+ * @param dictionary: terms to search
+ * @param automaton: automaton of the word to match
+ * @return every match, in sorted term order
+*/
+vector<FuzzyMatch> fuzzy_terms(const TermDictionary& dictionary, const LevenshteinAutomaton& automaton) {
+    vector<FuzzyMatch> matches;
+    vector<vector<int>> states(1); // states[d]: state after the first d characters of previous
+    string previous; // term the states were computed for
+    size_t computed = 0; // characters of previous the states cover
+    automaton.start(states[0]);
+    TermIterator it(dictionary);
+
+    while (!it.done()) {
+        const string& term = it.term();
+        size_t depth = 0;
+
+        while (depth < computed && depth < term.size() && term[depth] == previous[depth]) {
+            depth++; // states up to here are the same as previous's
+        }
+
+        size_t dead = 0; // length of the shortest dead prefix, 0 if there is none
+
+        for (; depth < term.size(); depth++) {
+            if (states.size() <= depth + 1) {
+                states.emplace_back();
+            }
+
+            automaton.step(states[depth], term[depth], states[depth + 1]);
+
+            if (!automaton.can_match(states[depth + 1])) {
+                dead = depth + 1;
+                break;
+            }
+        }
+
+        previous = term;
+        computed = dead > 0 ? dead : term.size();
+
+        if (dead == 0) {
+            if (automaton.is_match(states[term.size()])) {
+                matches.push_back({term, it.term_id(), automaton.distance(states[term.size()])});
+            }
+
+            it.next();
+            continue;
+        }
+
+        // skip every term starting with the dead prefix: seek to the first string after all of them
+        string successor = previous.substr(0, dead);
+
+        while (!successor.empty() && (unsigned char) successor.back() == 0xff) {
+            successor.pop_back();
+        }
+
+        if (successor.empty()) {
+            break;
+        }
+
+        successor.back()++;
+        it.seek(successor);
+    }
+
+    return matches;
+}
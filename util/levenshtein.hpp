@@ -0,0 +1,39 @@
+#ifndef LEVENSHTEIN_H
+#define LEVENSHTEIN_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "util/term_dictionary.hpp"
+using std::string;
+using std::string_view;
+using std::vector;
+
+// automaton accepting the strings within some edit distance (insertions, deletions, substitutions)
+// of a word. A state is a row of the edit distance table: how far the word's first i characters are
+// from the characters read so far, capped at max_edits + 1, so stepping a state costs one row
+class LevenshteinAutomaton {
+    private:
+        string word;
+        int max_edits;
+
+    public:
+        LevenshteinAutomaton(string_view target, int edits);
+
+        void start(vector<int>& state) const;
+        void step(const vector<int>& state, char c, vector<int>& next) const;
+        bool can_match(const vector<int>& state) const;
+        bool is_match(const vector<int>& state) const;
+        int distance(const vector<int>& state) const;
+};
+
+// term of a dictionary an automaton accepted
+struct FuzzyMatch {
+    string word;
+    int term_id;
+    int distance; // edits from the automaton's word
+};
+
+vector<FuzzyMatch> fuzzy_terms(const TermDictionary& dictionary, const LevenshteinAutomaton& automaton);
+
+#endif // LEVENSHTEIN_H
@@ -0,0 +1,68 @@
+#include "mapped_file.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * Constructor for MappedFile, maps the file if it is a regular file
+ * (pipes and the like can't be mapped, is_open() says so)
+ * @param path: path of the file
+*/
+MappedFile::MappedFile(const string& path) {
+    struct stat info;
+
+    // checked before opening, opening a pipe just to find out it can't be mapped would cut off its writer
+    if (stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+        return;
+    }
+
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        return;
+    }
+
+    if (fstat(fd, &info) == 0) {
+        size = info.st_size;
+
+        if (size == 0) {
+            mapped = true; // nothing to map, but nothing to read either
+        }
+        else {
+            void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (address != MAP_FAILED) {
+                data = static_cast<const char*>(address);
+                mapped = true;
+            }
+        }
+    }
+
+    close(fd); // the mapping keeps the file alive
+}
+
+/**
+ * Destructor for MappedFile, unmaps the file
+*/
+MappedFile::~MappedFile() {
+    if (data) {
+        munmap(const_cast<char*>(data), size);
+    }
+}
+
+/**
+ * Whether the file is mapped
+ * @return true if view() has the file's contents
+*/
+bool MappedFile::is_open() const {
+    return mapped;
+}
+
+/**
+ * Contents of the file
+ * @return view of the whole file, valid as long as the MappedFile
+*/
+string_view MappedFile::view() const {
+    return string_view(data, data ? size : 0);
+}
@@ -0,0 +1,26 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <string_view>
+using std::string;
+using std::string_view;
+
+// read-only memory mapping of a whole file, so it can be scanned and split without reading it first
+class MappedFile {
+    private:
+        const char* data = nullptr;
+        size_t size = 0;
+        bool mapped = false;
+
+    public:
+        MappedFile(const string& path);
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool is_open() const;
+        string_view view() const;
+};
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,208 @@
+#include "metrics.hpp"
+#include "alloc_profiling.hpp"
+#include <cstring>
+#include <cstdio>
+#include <sstream>
+using std::ostringstream;
+using std::lock_guard;
+
+const char* COUNTER_NAMES[NUM_COUNTERS] = {
+    "pages", "tokens", "stems", "links", "resolved_links", "terms", "postings", "position_bytes", "dictionary_bytes", "postings_bytes",
+    "page_rank_iterations",
+    "lock_waits", "lock_wait_nanos", "arena_blocks", "arena_bytes", "allocations", "allocated_bytes",
+    "queue_full_waits", "queue_empty_waits"
+};
+
+/**
+ * Constructor for Metrics, all counters start at 0
+*/
+Metrics::Metrics() {
+    for (auto& counter: counters) {
+        counter = 0;
+    }
+}
+
+/**
+ * Adds to a counter
+ * @param counter: counter to add to
+ * @param amount: amount to add
+*/
+void Metrics::add(Counter counter, long amount) {
+    counters[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+/**
+ * Reads a counter
+ * @param counter: counter to read
+ * @return value of the counter
+*/
+long Metrics::get(Counter counter) const {
+    return counters[counter].load(std::memory_order_relaxed);
+}
+
+/**
+ * Finds the timing of a phase, adding it if it is new (timings_mutex must be held)
+ * @param phase: name of the phase
+ * @return timing of the phase
+*/
+PhaseTiming& Metrics::phase_timing(const char* phase) {
+    for (PhaseTiming& timing: phases) {
+        if (strcmp(timing.name, phase) == 0) {
+            return timing;
+        }
+    }
+
+    phases.push_back(PhaseTiming());
+    phases.back().name = phase;
+
+    return phases.back();
+}
+
+/**
+ * Records the wall time of a phase or of a worker task in a phase
+ * @param phase: name of the phase
+ * @param worker: worker that ran the task, or -1 for the whole phase
+ * @param seconds: wall time
+ * @param allocations: calls to operator new during the whole phase, ignored for a task
+ * @param bytes: bytes they asked for, ignored for a task. Added to the counters unless the phase is a sub-phase
+*/
+void Metrics::record(const char* phase, int worker, double seconds, long allocations, long bytes) {
+    if (worker < 0 && !strchr(phase, '.')) {
+        add(ALLOCATIONS, allocations); // sub-phases are already part of their phase
+        add(ALLOCATED_BYTES, bytes);
+    }
+
+    lock_guard<mutex> guard(timings_mutex);
+    PhaseTiming& timing = phase_timing(phase);
+
+    if (worker < 0) {
+        timing.seconds += seconds;
+        timing.allocations += allocations;
+        return;
+    }
+
+    if ((int) timing.task_seconds.size() <= worker) {
+        timing.task_seconds.resize(worker + 1, 0);
+    }
+
+    timing.task_seconds[worker] += seconds;
+}
+
+/**
+ * Records the contention of a group of mutexes during a phase, and adds it to the lock counters
+ * @param phase: name of the phase
+ * @param mutexes: name of the group of mutexes
+ * @param slots: stats of every mutex in the group
+*/
+void Metrics::record_locks(const char* phase, const char* mutexes, const vector<LockStats>& slots) {
+    for (const LockStats& stats: slots) {
+        add(LOCK_WAITS, stats.contended);
+        add(LOCK_WAIT_NANOS, stats.wait_nanos);
+    }
+
+    lock_guard<mutex> guard(timings_mutex);
+    locks.push_back({phase, mutexes, slots});
+}
+
+/**
+ * Escapes a string for json, quotes, backslashes and control characters
+ * @param str: string to escape
+ * @return str as a quoted json string
+*/
+static string json_string(const string& str) {
+    string result = "\"";
+
+    for (char c: str) {
+        switch (c) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\b': result += "\\b"; break;
+            case '\f': result += "\\f"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if ((unsigned char) c < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char) c);
+                    result += escaped;
+                }
+                else {
+                    result += c;
+                }
+        }
+    }
+
+    return result + "\"";
+}
+
+/**
+ * Produces the machine-readable report of the run
+ * @param corpus: path of the corpus indexed
+ * @param threads: number of worker threads
+ * @return report as json
+*/
+string Metrics::to_json(const string& corpus, int threads) const {
+    lock_guard<mutex> guard(timings_mutex);
+    ostringstream json;
+    double total = 0;
+
+    json << "{\n  \"corpus\": " << json_string(corpus) << ",\n  \"threads\": " << threads << ",\n  \"phases\": [";
+
+    for (size_t i = 0; i < phases.size(); i++) {
+        json << (i > 0 ? "," : "") << "\n    {\"name\": \"" << phases[i].name << "\", \"seconds\": " << phases[i].seconds << ", \"task_seconds\": [";
+
+        for (size_t j = 0; j < phases[i].task_seconds.size(); j++) {
+            json << (j > 0 ? ", " : "") << phases[i].task_seconds[j];
+        }
+
+        json << "], \"allocations\": " << phases[i].allocations << "}";
+
+        if (!strchr(phases[i].name, '.')) {
+            total += phases[i].seconds; // sub-phases are already part of their phase
+        }
+    }
+
+    json << "\n  ],\n  \"total_seconds\": " << total << ",\n  \"counters\": {";
+
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        json << (i > 0 ? "," : "") << "\n    \"" << COUNTER_NAMES[i] << "\": " << get((Counter) i);
+    }
+
+    json << "\n  },\n  \"locks\": [";
+
+    for (size_t i = 0; i < locks.size(); i++) {
+        json << (i > 0 ? "," : "") << "\n    {\"phase\": \"" << locks[i].phase << "\", \"mutexes\": \"" << locks[i].mutexes << "\", \"slots\": [";
+
+        for (size_t j = 0; j < locks[i].slots.size(); j++) {
+            const LockStats& stats = locks[i].slots[j];
+            json << (j > 0 ? "," : "") << "\n      {\"acquisitions\": " << stats.acquisitions << ", \"contended\": " << stats.contended
+                 << ", \"wait_nanos\": " << stats.wait_nanos << "}";
+        }
+
+        json << "\n    ]}";
+    }
+
+    json << "\n  ]\n}\n";
+
+    return json.str();
+}
+
+/**
+ * Constructor for ScopedTimer, starts timing
+ * @param owner: metrics to record the time in
+ * @param phase_name: name of the phase, must outlive the metrics (a string literal)
+ * @param worker_num: worker running the task, or -1 to time the whole phase
+*/
+ScopedTimer::ScopedTimer(Metrics& owner, const char* phase_name, int worker_num)
+    : metrics(owner), phase(phase_name), worker(worker_num), start(std::chrono::steady_clock::now()),
+      start_allocations(allocation_count()), start_bytes(allocated_bytes()) {}
+
+/**
+ * Destructor for ScopedTimer, records the time elapsed since construction, and for a whole phase the
+ * allocations too (a task's would count the other workers' as well)
+*/
+ScopedTimer::~ScopedTimer() {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    metrics.record(phase, worker, elapsed.count(), allocation_count() - start_allocations, allocated_bytes() - start_bytes);
+}
@@ -0,0 +1,91 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include "util/profiled_mutex.hpp"
+using std::string;
+using std::vector;
+using std::array;
+using std::atomic;
+using std::mutex;
+
+// counters of an indexing run, workers add to them once per task rather than per token
+enum Counter {
+    PAGES, // pages processed
+    TOKENS, // tokens scanned, including the tokens inside links
+    STEMS, // words stemmed (tokens that are not stop words)
+    LINKS, // raw links recorded
+    RESOLVED_LINKS, // links left after resolving targets to doc ids
+    TERMS, // distinct terms in the corpus
+    POSTINGS, // (term, doc) relevances computed
+    POSITION_BYTES, // bytes of position entries, if positions are kept (one position per stem)
+    DICTIONARY_BYTES, // bytes of the sorted term dictionary
+    POSTINGS_BYTES, // bytes of the postings, doc ids and exact or quantized scores
+    PAGE_RANK_ITERATIONS,
+    LOCK_WAITS, // lock acquisitions, and page queue pushes and pops, that had to wait (LOCK_PROFILING builds only)
+    LOCK_WAIT_NANOS, // total time spent waiting for locks (LOCK_PROFILING builds only)
+    ARENA_BLOCKS, // blocks allocated by the per-worker arenas
+    ARENA_BYTES, // bytes allocated by the per-worker arenas
+    ALLOCATIONS, // calls to operator new during the phases (ALLOC_PROFILING builds only)
+    ALLOCATED_BYTES, // bytes asked of operator new during the phases (ALLOC_PROFILING builds only)
+    QUEUE_FULL_WAITS, // pushes onto a full ingest queue, a later stage is the bottleneck
+    QUEUE_EMPTY_WAITS, // pops from an empty ingest queue, an earlier stage is the bottleneck
+    NUM_COUNTERS
+};
+
+// wall time of a phase, and of every worker task in it
+struct PhaseTiming {
+    const char* name;
+    double seconds = 0;
+    vector<double> task_seconds; // worker -> seconds
+    long allocations = 0; // calls to operator new during the phase (ALLOC_PROFILING builds only)
+};
+
+// contention of every slot of a group of mutexes during a phase
+struct LockReport {
+    const char* phase;
+    const char* mutexes; // name of the group of mutexes
+    vector<LockStats> slots; // slot -> stats
+};
+
+// low overhead instrumentation of an indexing run, reported as json
+class Metrics {
+    private:
+        mutable mutex timings_mutex; // guards phases and locks
+        vector<PhaseTiming> phases; // in order of first report
+        vector<LockReport> locks; // in order of report
+        array<atomic<long>, NUM_COUNTERS> counters;
+
+        PhaseTiming& phase_timing(const char* phase);
+
+    public:
+        Metrics();
+        void add(Counter counter, long amount);
+        long get(Counter counter) const;
+        void record(const char* phase, int worker, double seconds, long allocations = 0, long bytes = 0);
+        void record_locks(const char* phase, const char* mutexes, const vector<LockStats>& slots);
+        string to_json(const string& corpus, int threads) const;
+};
+
+// records the wall time of its own lifetime as a phase (worker -1) or as a worker task of a phase,
+// and the allocations of a phase
+class ScopedTimer {
+    private:
+        Metrics& metrics;
+        const char* phase;
+        int worker;
+        std::chrono::steady_clock::time_point start;
+        long start_allocations; // allocations of the whole program when the timer started
+        long start_bytes; // bytes they asked for
+
+    public:
+        ScopedTimer(Metrics& owner, const char* phase_name, int worker_num = -1);
+        ~ScopedTimer();
+};
+
+#endif // METRICS_H
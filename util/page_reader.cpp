@@ -0,0 +1,158 @@
+#include "page_reader.hpp"
+
+/**
+ * Constructor for PageReader, opens the corpus
+ * @param path: path of the xml corpus, compressed or not
+ * @param threads: threads for decompressing, if the format allows more than one
+ * @param chunk: bytes to read from the corpus at a time
+*/
+PageReader::PageReader(const string& path, int threads, size_t chunk) : source(open_source(path, threads)), chunk_size(chunk) {
+    opened = source != nullptr;
+}
+
+/**
+ * Whether the corpus could be opened
+ * @return true if pages can be read
+*/
+bool PageReader::is_open() const {
+    return opened;
+}
+
+/**
+ * Whether reading stopped early, because the corpus is corrupt or could not be read partway
+ * @return true if pages were lost
+*/
+bool PageReader::failed() const {
+    return error;
+}
+
+/**
+ * Threads the corpus is decompressed on besides the one reading pages, only multistream bzip2 has any
+ * @return threads
+*/
+int PageReader::decompression_threads() const {
+    return source ? source->thread_count() : 0;
+}
+
+/**
+ * Reads the next page of the corpus, reading more of the file as needed
+ * @param page: set to the xml of the page, from "<page" to "</page>", valid until the next call
+ * @return false once there are no pages left
+*/
+bool PageReader::next(string_view& page) {
+    while (true) {
+        if (find_page(buffer, pos, page)) {
+            return true;
+        }
+
+        if (!source) {
+            return false;
+        }
+
+        // drop what has been scanned past, then read another chunk after what is left
+        buffer.erase(0, pos);
+        pos = 0;
+        size_t size = buffer.size();
+        buffer.resize(size + chunk_size);
+        size_t read = source->read(&buffer[size], chunk_size);
+        buffer.resize(size + read);
+
+        if (read == 0) {
+            error = source->failed();
+            source.reset(); // end of the corpus, whatever is left is not a complete page
+        }
+    }
+}
+
+/**
+ * Finds the next complete page in a buffer of xml
+ * @param data: xml to search
+ * @param from: where to start searching, moved past the page found, or to where the next
+ *              page could start if there is no complete page
+ * @param page: set to the xml of the page found, from "<page" to "</page>"
+ * @return whether a complete page was found
+*/
+bool PageReader::find_page(string_view data, size_t& from, string_view& page) {
+    while (true) {
+        size_t open = data.find("<page", from);
+
+        if (open == string_view::npos) {
+            // keep a tail that could be the start of a "<page" split across chunks
+            if (data.size() > from + 4) {
+                from = data.size() - 4;
+            }
+
+            return false;
+        }
+
+        if (open + 5 == data.size()) {
+            from = open; // can't tell what the tag is yet
+            return false;
+        }
+
+        char after = data[open + 5];
+
+        if (after != '>' && after != ' ' && after != '\t' && after != '\n' && after != '\r') {
+            from = open + 5; // some other tag, like "<pages>"
+            continue;
+        }
+
+        size_t close = data.find("</page>", open);
+
+        if (close == string_view::npos) {
+            from = open; // incomplete page
+            return false;
+        }
+
+        page = data.substr(open, close + 7 - open);
+        from = close + 7;
+
+        return true;
+    }
+}
+
+/**
+ * Splits a corpus into about equally sized ranges on page boundaries
+ * @param data: xml of the whole corpus
+ * @param parts: number of ranges wanted, fewer come back if pages are large
+ * @return ranges in order, covering every page, first_doc still unset
+*/
+vector<PageRange> PageReader::split_pages(string_view data, int parts) {
+    vector<PageRange> ranges;
+    size_t begin = 0;
+
+    for (int i = 1; i <= parts; i++) {
+        size_t end = data.size();
+
+        // move the split point forward to the start of the next page
+        if (i < parts) {
+            size_t from = data.size() / parts * i;
+            string_view page;
+            end = find_page(data, from, page) ? page.data() - data.data() : data.size();
+        }
+
+        if (end > begin) {
+            ranges.push_back({begin, end});
+            begin = end;
+        }
+    }
+
+    return ranges;
+}
+
+/**
+ * Counts the complete pages in a buffer of xml, without parsing them
+ * @param data: xml to search
+ * @return number of pages
+*/
+int PageReader::count_pages(string_view data) {
+    size_t from = 0;
+    string_view page;
+    int count = 0;
+
+    while (find_page(data, from, page)) {
+        count++;
+    }
+
+    return count;
+}
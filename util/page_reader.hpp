@@ -0,0 +1,44 @@
+#ifndef PAGE_READER_H
+#define PAGE_READER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "util/byte_source.hpp"
+using std::string;
+using std::string_view;
+using std::vector;
+
+// byte range of a corpus that starts at a page and ends where another page (or the corpus) starts,
+// so it can be parsed on its own
+struct PageRange {
+    size_t begin;
+    size_t end;
+    int first_doc = 0; // dense doc id of the range's first page
+};
+
+// streams the <page> elements of an xml corpus out of a file a chunk at a time, decompressing it
+// on the way if need be, so the whole corpus is never in memory (or on disk uncompressed) at once
+class PageReader {
+    private:
+        unique_ptr<ByteSource> source; // null once the source runs out
+        bool opened; // the source could be opened
+        bool error = false; // the source failed partway
+        string buffer; // unconsumed bytes read so far
+        size_t pos = 0; // first byte of buffer not yet scanned past
+        size_t chunk_size; // bytes read from the file at a time
+
+    public:
+        PageReader(const string& path, int threads = 1, size_t chunk = 1 << 20);
+
+        bool is_open() const;
+        bool failed() const;
+        int decompression_threads() const;
+        bool next(string_view& page);
+
+        static bool find_page(string_view data, size_t& from, string_view& page);
+        static vector<PageRange> split_pages(string_view data, int parts);
+        static int count_pages(string_view data);
+};
+
+#endif // PAGE_READER_H
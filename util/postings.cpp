@@ -0,0 +1,261 @@
+#include "postings.hpp"
+#include "score_kernels.hpp"
+#include "varint.hpp"
+#include <cmath>
+#include <algorithm>
+using std::lround;
+using std::max;
+using std::min;
+using std::copy;
+
+/**
+ * Decodes the doc ids of a block
+ * @param block: block number
+ * @param out: where to put them, room for POSTING_BLOCK
+ * @return number of doc ids in the block
+*/
+size_t PostingList::decode_block(size_t block, int* out) const {
+    size_t start = block * POSTING_BLOCK;
+    size_t n = min(POSTING_BLOCK, size - start);
+
+    if (docs) {
+        copy(docs + start, docs + start + n, out);
+        return n;
+    }
+
+    const unsigned char* next = (const unsigned char*) gaps + blocks[block].gaps;
+    int doc = blocks[block].first;
+    out[0] = doc;
+
+    for (size_t i = 1; i < n; i++) {
+        uint32_t gap = *next++;
+
+        // most gaps fit in a byte, only rare terms' lists have longer ones
+        if (gap >= 0x80) {
+            gap &= 0x7f;
+            int shift = 7;
+            unsigned char byte;
+
+            do {
+                byte = *next++;
+                gap |= (uint32_t) (byte & 0x7f) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+        }
+
+        doc += gap;
+        out[i] = doc;
+    }
+
+    return n;
+}
+
+/**
+ * Adds the score of every posting to the accumulator of its doc, a block at a time, with a kernel per
+ * score layout
+ * @param accumulators: dense doc ids -> scores so far
+*/
+void PostingList::add_to(double* accumulators) const {
+    int block_docs[POSTING_BLOCK];
+
+    for (size_t block = 0; block < num_blocks(); block++) {
+        size_t start = block * POSTING_BLOCK;
+        size_t n = decode_block(block, block_docs);
+
+        if (scores) {
+            add_scores(accumulators, block_docs, scores + start, n);
+        }
+        else if (impacts8) {
+            add_impacts8(accumulators, block_docs, impacts8 + start, n, scale);
+        }
+        else {
+            add_impacts16(accumulators, block_docs, impacts16 + start, n, scale);
+        }
+    }
+}
+
+/**
+ * Constructor for Postings
+ * @param impact_bits: 8 or 16 to quantize scores to impacts of that many bits, 0 to keep them exact
+ * @param one_scale: whether impacts share one scale over the whole index rather than one per term
+*/
+Postings::Postings(int impact_bits, bool one_scale) : bits(impact_bits), global_scale(one_scale && impact_bits > 0) {}
+
+/**
+ * Lays out the postings of every term, replacing what was there, so terms can then be filled in any
+ * order and from any thread. The doc ids are looked at to size their gaps
+ * @param lists: term ids -> (dense doc ids, scores), sorted by doc id, what fill gets later
+*/
+void Postings::allocate(const vector<vector<pair<int, double>>>& lists) {
+    offsets.assign(1, 0);
+    block_offsets.assign(1, 0);
+    gap_offsets.assign(1, 0);
+
+    for (const auto& list: lists) {
+        size_t gap_bytes = 0;
+
+        for (size_t i = 0; i < list.size(); i++) {
+            if (i % POSTING_BLOCK != 0) {
+                gap_bytes += varint_length(list[i].first - list[i - 1].first);
+            }
+        }
+
+        offsets.push_back(offsets.back() + list.size());
+        block_offsets.push_back(block_offsets.back() + (list.size() + POSTING_BLOCK - 1) / POSTING_BLOCK);
+        gap_offsets.push_back(gap_offsets.back() + gap_bytes);
+    }
+
+    size_t total = offsets.back();
+    blocks.assign(block_offsets.back(), {0, 0});
+    gaps.assign(gap_offsets.back(), 0);
+    scores.assign(bits == 0 ? total : 0, 0);
+    impacts8.assign(bits == 8 ? total : 0, 0);
+    impacts16.assign(bits == 16 ? total : 0, 0);
+    scales.assign(global_scale ? 1 : lists.size(), 1);
+}
+
+/**
+ * Sets the global scale from the highest score of any posting, which then gets the highest impact.
+ * Only needed with a global scale, and before any term is filled
+ * @param max_score: highest score of any posting
+*/
+void Postings::set_max_score(double max_score) {
+    if (global_scale && max_score > 0) {
+        scales[0] = max_score / max_impact();
+    }
+}
+
+/**
+ * Rounds a score to the nearest impact, a positive score never rounding down to 0 so the posting still counts
+ * @param score: exact score
+ * @param scale: score of an impact of 1
+ * @return impact
+*/
+int Postings::quantize(double score, double scale) const {
+    if (score <= 0) {
+        return 0;
+    }
+
+    return (int) max(1L, min((long) max_impact(), lround(score / scale)));
+}
+
+/**
+ * Copies the postings of a term in, quantizing their scores if impacts are kept. With a scale per
+ * term, the term's highest score gets the highest impact
+ * @param term_id: term id
+ * @param list: (dense doc ids, scores) of the term, sorted by doc id, as many as allocated for it
+*/
+void Postings::fill(int term_id, const vector<pair<int, double>>& list) {
+    size_t start = offsets[term_id];
+    DocBlock* term_blocks = blocks.data() + block_offsets[term_id];
+    char* term_gaps = gaps.data() + gap_offsets[term_id];
+    size_t written = 0; // bytes of the term's gaps so far
+
+    for (size_t i = 0; i < list.size(); i++) {
+        if (i % POSTING_BLOCK == 0) {
+            term_blocks[i / POSTING_BLOCK] = {list[i].first, (uint32_t) written};
+        }
+        else {
+            put_varint(term_gaps, written, list[i].first - list[i - 1].first);
+        }
+    }
+
+    if (bits == 0) {
+        for (size_t i = 0; i < list.size(); i++) {
+            scores[start + i] = list[i].second;
+        }
+
+        return;
+    }
+
+    if (!global_scale) {
+        double max_score = 0;
+
+        for (const auto& posting: list) {
+            max_score = max(max_score, posting.second);
+        }
+
+        scales[term_id] = max_score > 0 ? max_score / max_impact() : 1;
+    }
+
+    double scale = scales[global_scale ? 0 : term_id];
+
+    for (size_t i = 0; i < list.size(); i++) {
+        int impact = quantize(list[i].second, scale);
+
+        if (bits == 8) {
+            impacts8[start + i] = impact;
+        }
+        else {
+            impacts16[start + i] = impact;
+        }
+    }
+}
+
+/**
+ * Bits of an impact
+ * @return 8 or 16, 0 if scores are exact
+*/
+int Postings::impact_bits() const {
+    return bits;
+}
+
+/**
+ * Highest impact a score can be quantized to
+ * @return 255 or 65535, 0 if scores are exact
+*/
+int Postings::max_impact() const {
+    return bits == 0 ? 0 : (1 << bits) - 1;
+}
+
+/**
+ * Number of terms laid out
+ * @return terms
+*/
+int Postings::num_terms() const {
+    return offsets.empty() ? 0 : offsets.size() - 1;
+}
+
+/**
+ * Number of postings of every term
+ * @return postings
+*/
+size_t Postings::size() const {
+    return offsets.empty() ? 0 : offsets.back();
+}
+
+/**
+ * Memory taken by the postings
+ * @return bytes of the doc id blocks and gaps, scores or impacts, offsets and scales
+*/
+size_t Postings::memory_bytes() const {
+    return blocks.capacity() * sizeof(DocBlock) + gaps.capacity() + scores.capacity() * sizeof(double) +
+        impacts8.capacity() * sizeof(uint8_t) + impacts16.capacity() * sizeof(uint16_t) +
+        (offsets.capacity() + block_offsets.capacity() + gap_offsets.capacity()) * sizeof(size_t) + scales.capacity() * sizeof(double);
+}
+
+/**
+ * Postings of a term
+ * @param term_id: term id
+ * @return view of its postings, valid as long as the postings aren't laid out again
+*/
+PostingList Postings::list(int term_id) const {
+    PostingList postings;
+    size_t start = offsets[term_id];
+    postings.blocks = blocks.data() + block_offsets[term_id];
+    postings.gaps = gaps.data() + gap_offsets[term_id];
+    postings.size = offsets[term_id + 1] - start;
+    postings.scale = scales[global_scale ? 0 : term_id];
+
+    if (bits == 0) {
+        postings.scores = scores.data() + start;
+    }
+    else if (bits == 8) {
+        postings.impacts8 = impacts8.data() + start;
+    }
+    else {
+        postings.impacts16 = impacts16.data() + start;
+    }
+
+    return postings;
+}
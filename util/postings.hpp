@@ -0,0 +1,107 @@
+#ifndef POSTINGS_H
+#define POSTINGS_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+using std::vector;
+using std::pair;
+
+const size_t POSTING_BLOCK = 128; // postings per block of encoded doc ids
+
+// doc ids of a block of postings: the first one as is, the others as varint gaps from the one before
+struct DocBlock {
+    int first; // dense doc id of the block's first posting
+    uint32_t gaps; // where the gaps to its other postings start, from the start of the term's gaps
+};
+
+// one term's postings as queries read them: dense doc ids in ascending order, encoded in blocks of
+// POSTING_BLOCK (or as is, for lists computed at query time), and next to each its score, either exact
+// or an 8 or 16 bit impact that the scale turns back into a score
+struct PostingList {
+    const DocBlock* blocks = nullptr; // blocks of the encoded doc ids
+    const char* gaps = nullptr; // varint gaps of the encoded doc ids
+    const int* docs = nullptr; // doc ids as is, null if encoded
+    size_t size = 0;
+    const double* scores = nullptr; // exact scores, null if quantized
+    const uint8_t* impacts8 = nullptr; // impacts, if quantized to 8 bits
+    const uint16_t* impacts16 = nullptr; // impacts, if quantized to 16 bits
+    double scale = 1; // score of an impact of 1
+
+    /**
+     * Score of a posting
+     * @param i: posting number
+     * @return its score, exact or dequantized
+    */
+    double score(size_t i) const {
+        return scores ? scores[i] : impact(i) * scale;
+    }
+
+    /**
+     * Impact of a posting
+     * @param i: posting number
+     * @return its impact, only if quantized
+    */
+    int impact(size_t i) const {
+        return impacts8 ? impacts8[i] : impacts16[i];
+    }
+
+    /**
+     * Number of blocks of doc ids, the last one possibly not full
+     * @return blocks
+    */
+    size_t num_blocks() const {
+        return (size + POSTING_BLOCK - 1) / POSTING_BLOCK;
+    }
+
+    /**
+     * First doc of a block, without decoding it
+     * @param block: block number
+     * @return dense doc id
+    */
+    int first_doc(size_t block) const {
+        return docs ? docs[block * POSTING_BLOCK] : blocks[block].first;
+    }
+
+    size_t decode_block(size_t block, int* out) const;
+    void add_to(double* accumulators) const;
+};
+
+// postings of every term in flat arrays, the doc ids of all terms back to back and their scores in a
+// parallel array. Doc ids are delta encoded in blocks, 8 bytes a block plus a varint gap a posting,
+// 1 byte for most postings; scores take 8 bytes a posting exact, 2 or 1 as impacts of 16 or 8 bits.
+// Impacts are scores rounded to multiples of a scale, stored once per term (so every term keeps its
+// full range, the default) or once for the whole index (so impacts of different terms can be added
+// as integers, but the scores of rarer terms, far below the highest one, lose most of their precision)
+class Postings {
+    private:
+        int bits; // bits of an impact, 0 for exact scores
+        bool global_scale; // one scale for every term
+        vector<size_t> offsets; // term ids -> first posting, with the end of the last term's postings at the back
+        vector<size_t> block_offsets; // term ids -> first block, the same way
+        vector<size_t> gap_offsets; // term ids -> first byte of their gaps, the same way
+        vector<DocBlock> blocks; // doc ids of every block of postings, blocks of each term in order
+        vector<char> gaps; // varint gaps between the doc ids of each block
+        vector<double> scores; // exact scores, if not quantized
+        vector<uint8_t> impacts8; // impacts, if quantized to 8 bits
+        vector<uint16_t> impacts16; // impacts, if quantized to 16 bits
+        vector<double> scales; // term ids -> score of an impact of 1, a single one with a global scale
+
+        int quantize(double score, double scale) const;
+
+    public:
+        Postings(int impact_bits = 0, bool one_scale = false);
+
+        void allocate(const vector<vector<pair<int, double>>>& lists);
+        void set_max_score(double max_score);
+        void fill(int term_id, const vector<pair<int, double>>& list);
+
+        int impact_bits() const;
+        int max_impact() const;
+        int num_terms() const;
+        size_t size() const;
+        size_t memory_bytes() const;
+        PostingList list(int term_id) const;
+};
+
+#endif // POSTINGS_H
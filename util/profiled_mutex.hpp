@@ -0,0 +1,76 @@
+#ifndef PROFILED_MUTEX_H
+#define PROFILED_MUTEX_H
+
+#include <shared_mutex>
+#include <atomic>
+#include <chrono>
+using std::shared_mutex;
+using std::atomic;
+
+// contention of one mutex since its stats were last taken
+struct LockStats {
+    long acquisitions = 0; // exclusive and shared
+    long contended = 0; // acquisitions that had to wait
+    long wait_nanos = 0; // total time spent waiting
+};
+
+// drop-in shared_mutex that profiles its contention when built with LOCK_PROFILING ("make LOCKPROF=1"),
+// and is a plain shared_mutex otherwise
+class ProfiledMutex {
+    private:
+        shared_mutex inner;
+#ifdef LOCK_PROFILING
+        atomic<long> acquisitions{0};
+        atomic<long> contended{0};
+        atomic<long> wait_nanos{0};
+
+        /**
+         * Acquires the mutex, timing the wait if it is held by someone else
+         * @param try_acquire: tries to acquire without blocking
+         * @param acquire: acquires, blocking
+        */
+        template <typename Try, typename Acquire>
+        void acquire_profiled(Try try_acquire, Acquire acquire) {
+            acquisitions.fetch_add(1, std::memory_order_relaxed);
+
+            if (try_acquire()) {
+                return; // uncontended!
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            acquire();
+            auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            contended.fetch_add(1, std::memory_order_relaxed);
+            wait_nanos.fetch_add(waited.count(), std::memory_order_relaxed);
+        }
+#endif
+
+    public:
+#ifdef LOCK_PROFILING
+        void lock() { acquire_profiled([&]() { return inner.try_lock(); }, [&]() { inner.lock(); }); }
+        void lock_shared() { acquire_profiled([&]() { return inner.try_lock_shared(); }, [&]() { inner.lock_shared(); }); }
+#else
+        void lock() { inner.lock(); }
+        void lock_shared() { inner.lock_shared(); }
+#endif
+        bool try_lock() { return inner.try_lock(); }
+        bool try_lock_shared() { return inner.try_lock_shared(); }
+        void unlock() { inner.unlock(); }
+        void unlock_shared() { inner.unlock_shared(); }
+
+        /**
+         * Takes the contention stats gathered so far and starts over
+         * @return stats since the last call (all 0 without LOCK_PROFILING)
+        */
+        LockStats take_stats() {
+            LockStats stats;
+#ifdef LOCK_PROFILING
+            stats.acquisitions = acquisitions.exchange(0);
+            stats.contended = contended.exchange(0);
+            stats.wait_nanos = wait_nanos.exchange(0);
+#endif
+            return stats;
+        }
+};
+
+#endif // PROFILED_MUTEX_H
@@ -0,0 +1,185 @@
+#include "result_cache.hpp"
+#include <algorithm>
+#include <functional>
+using std::lock_guard;
+using std::max;
+using std::min;
+using std::hash;
+
+static const int MAX_SHARDS = 16;
+static const size_t ENTRY_OVERHEAD = 128; // list and hash table nodes, and the entry itself
+
+/**
+ * Constructor for ResultCache, nothing is cached if either limit is 0
+ * @param entries: results kept at most
+ * @param bytes: memory the results take at most, roughly
+*/
+ResultCache::ResultCache(long entries, long bytes) :
+    num_shards((int) max(1L, min((long) MAX_SHARDS, entries))), shards(new Shard[num_shards]),
+    max_entries(max(0L, entries) / num_shards + (entries % num_shards > 0)), max_bytes(max(0L, bytes) / num_shards) {}
+
+/**
+ * Makes the key of a query's results: its terms in order, since the order scores are added up in can change
+ * their last bits, and the options it was ranked with
+ * @param terms: stemmed terms of the query, from Query::tokenize_input
+ * @param k: max number of documents ranked
+ * @param use_page_rank: whether pagerank is included in scoring
+ * @param budget: postings a score-at-a-time ranking processed at most, 0 if it was exact
+ * @return key
+*/
+string ResultCache::make_key(const vector<string>& terms, int k, bool use_page_rank, long budget) {
+    string key;
+
+    for (const string& term: terms) {
+        key += term;
+        key += ' ';
+    }
+
+    key += '\t' + std::to_string(k) + (use_page_rank ? "\tpagerank" : "");
+
+    if (budget > 0) {
+        key += "\tbudget " + std::to_string(budget);
+    }
+
+    return key;
+}
+
+/**
+ * Whether anything is cached at all
+ * @return false if a limit is 0
+*/
+bool ResultCache::enabled() const {
+    return max_entries > 0 && max_bytes > 0;
+}
+
+/**
+ * Generation of the index results are computed in, to read before the index is
+ * @return generation, for put
+*/
+long ResultCache::generation() const {
+    return current_generation.load();
+}
+
+/**
+ * Shard a key is in
+ * @param key: key of a query's results
+ * @return shard
+*/
+ResultCache::Shard& ResultCache::shard(const string& key) const {
+    return shards[hash<string>()(key) % num_shards];
+}
+
+/**
+ * Drops the least recently used results of a shard until there is room for one more, of some size.
+ * Called with the shard locked
+ * @param shard: shard to make room in
+ * @param room: bytes of the results to make room for
+*/
+void ResultCache::evict(Shard& shard, size_t room) {
+    while (!shard.entries.empty() && (shard.entries.size() >= max_entries || shard.bytes + room > max_bytes)) {
+        Entry& last = shard.entries.back();
+        shard.bytes -= last.bytes;
+        shard.positions.erase(last.key);
+        shard.entries.pop_back();
+        evictions++;
+    }
+}
+
+/**
+ * Looks up the results of a query, making them the most recently used
+ * @param key: key of the query, from make_key
+ * @param results: set to the cached results if there are any
+ * @return true on a hit
+*/
+bool ResultCache::get(const string& key, vector<pair<int, double>>& results) {
+    if (!enabled()) {
+        return false;
+    }
+
+    Shard& owner = shard(key);
+    lock_guard<mutex> guard(owner.shard_mutex);
+    auto it = owner.positions.find(key);
+
+    if (it == owner.positions.end()) {
+        misses++;
+        return false;
+    }
+
+    owner.entries.splice(owner.entries.begin(), owner.entries, it->second);
+    results = it->second->results;
+    hits++;
+
+    return true;
+}
+
+/**
+ * Keeps the results of a query, unless the index changed since they were computed or they are too large
+ * for their shard
+ * @param key: key of the query, from make_key
+ * @param results: its results
+ * @param generation: generation read before the results were computed
+*/
+void ResultCache::put(const string& key, const vector<pair<int, double>>& results, long generation) {
+    size_t bytes = 2 * key.size() + results.size() * sizeof(pair<int, double>) + ENTRY_OVERHEAD;
+
+    if (!enabled() || bytes > max_bytes) {
+        return;
+    }
+
+    Shard& owner = shard(key);
+    lock_guard<mutex> guard(owner.shard_mutex);
+
+    if (generation != current_generation.load()) {
+        return; // computed against an index that is gone, invalidate already cleared this shard or is about to
+    }
+
+    auto it = owner.positions.find(key);
+
+    if (it != owner.positions.end()) {
+        owner.bytes -= it->second->bytes; // computed twice at once, the later one wins
+        owner.entries.erase(it->second);
+        owner.positions.erase(it);
+    }
+
+    evict(owner, bytes);
+    owner.entries.push_front({key, results, bytes});
+    owner.positions[key] = owner.entries.begin();
+    owner.bytes += bytes;
+}
+
+/**
+ * Drops every result, for when the index is reloaded. Results of queries still running against the old index
+ * are turned away by put
+*/
+void ResultCache::invalidate() {
+    current_generation++;
+
+    for (int i = 0; i < num_shards; i++) {
+        lock_guard<mutex> guard(shards[i].shard_mutex);
+        shards[i].entries.clear();
+        shards[i].positions.clear();
+        shards[i].bytes = 0;
+    }
+
+    invalidations++;
+}
+
+/**
+ * Lookups since the cache was made, and what it holds
+ * @return stats
+*/
+CacheStats ResultCache::stats() const {
+    CacheStats stats;
+    stats.hits = hits.load();
+    stats.misses = misses.load();
+    stats.evictions = evictions.load();
+    stats.invalidations = invalidations.load();
+
+    for (int i = 0; i < num_shards; i++) {
+        lock_guard<mutex> guard(shards[i].shard_mutex);
+        stats.entries += shards[i].entries.size();
+        stats.bytes += shards[i].bytes;
+    }
+
+    return stats;
+}
@@ -0,0 +1,79 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstddef>
+using std::string;
+using std::vector;
+using std::pair;
+using std::list;
+using std::unordered_map;
+using std::unique_ptr;
+using std::mutex;
+using std::atomic;
+
+// lookups of a result cache since it was made, and what it holds
+struct CacheStats {
+    long hits = 0;
+    long misses = 0;
+    long evictions = 0; // least recently used results dropped to stay within the limits
+    long invalidations = 0; // times every result was dropped, once for every index the cache was attached to
+    long entries = 0; // results held
+    long bytes = 0; // memory they take, roughly
+};
+
+// top k results of queries by key, the least recently used dropped once there are more than a number of
+// them or they take more than a number of bytes. Split into shards by the hash of the key, each with its
+// own lock and its share of the limits, so concurrent queries mostly lock different shards. Invalidating
+// drops everything and starts a new generation, and results computed in an older one are never kept
+class ResultCache {
+    private:
+        // results of a query, in its shard's recency list
+        struct Entry {
+            string key;
+            vector<pair<int, double>> results;
+            size_t bytes;
+        };
+
+        // a share of the cache, most recently used first
+        struct Shard {
+            mutex shard_mutex; // guards everything in the shard
+            list<Entry> entries;
+            unordered_map<string, list<Entry>::iterator> positions; // keys -> entries
+            size_t bytes = 0;
+        };
+
+        int num_shards;
+        unique_ptr<Shard[]> shards;
+        size_t max_entries; // per shard
+        size_t max_bytes; // per shard
+        atomic<long> current_generation{0};
+        atomic<long> hits{0};
+        atomic<long> misses{0};
+        atomic<long> evictions{0};
+        atomic<long> invalidations{0};
+
+        Shard& shard(const string& key) const;
+        void evict(Shard& shard, size_t room);
+
+    public:
+        ResultCache(long entries, long bytes);
+        ResultCache(const ResultCache&) = delete;
+        ResultCache& operator=(const ResultCache&) = delete;
+
+        static string make_key(const vector<string>& terms, int k, bool use_page_rank, long budget);
+        bool enabled() const;
+        long generation() const;
+        bool get(const string& key, vector<pair<int, double>>& results);
+        void put(const string& key, const vector<pair<int, double>>& results, long generation);
+        void invalidate();
+        CacheStats stats() const;
+};
+
+#endif // RESULT_CACHE_H
@@ -0,0 +1,360 @@
+#include "score_kernels.hpp"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS
+#endif
+
+/**
+ * Whether the CPU runs AVX2, checked once
+ * @return true if the AVX2 kernels can be used
+*/
+bool has_avx2() {
+#ifdef HAVE_X86_KERNELS
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Adds scores to the accumulators of their docs
+ * @param accumulators: dense doc ids -> scores so far
+ * @param docs: dense doc ids, distinct and ascending
+ * @param scores: score of each doc
+ * @param n: number of docs
+*/
+void add_scores(double* accumulators, const int* docs, const double* scores, size_t n) {
+    has_avx2() ? add_scores_avx2(accumulators, docs, scores, n) : add_scores_scalar(accumulators, docs, scores, n);
+}
+
+/**
+ * Adds 8 bit impacts, times a scale, to the accumulators of their docs
+ * @param accumulators: dense doc ids -> scores so far
+ * @param docs: dense doc ids, distinct and ascending
+ * @param impacts: impact of each doc
+ * @param n: number of docs
+ * @param scale: score of an impact of 1
+*/
+void add_impacts8(double* accumulators, const int* docs, const uint8_t* impacts, size_t n, double scale) {
+    has_avx2() ? add_impacts8_avx2(accumulators, docs, impacts, n, scale) : add_impacts8_scalar(accumulators, docs, impacts, n, scale);
+}
+
+/**
+ * Adds 16 bit impacts, times a scale, to the accumulators of their docs
+ * @param accumulators: dense doc ids -> scores so far
+ * @param docs: dense doc ids, distinct and ascending
+ * @param impacts: impact of each doc
+ * @param n: number of docs
+ * @param scale: score of an impact of 1
+*/
+void add_impacts16(double* accumulators, const int* docs, const uint16_t* impacts, size_t n, double scale) {
+    has_avx2() ? add_impacts16_avx2(accumulators, docs, impacts, n, scale) : add_impacts16_scalar(accumulators, docs, impacts, n, scale);
+}
+
+/**
+ * Adds the same score to the accumulators of some docs, like a segment of postings of equal impact
+ * @param accumulators: dense doc ids -> scores so far
+ * @param docs: dense doc ids, distinct and ascending
+ * @param n: number of docs
+ * @param score: score to add to each
+*/
+void add_constant(double* accumulators, const int* docs, size_t n, double score) {
+    has_avx2() ? add_constant_avx2(accumulators, docs, n, score) : add_constant_scalar(accumulators, docs, n, score);
+}
+
+/**
+ * Multiplies scores by weights, element by element
+ * @param scores: scores to weight, in place
+ * @param weights: weight of each score, like page ranks
+ * @param n: number of scores
+*/
+void multiply_scores(double* scores, const double* weights, size_t n) {
+    has_avx2() ? multiply_scores_avx2(scores, weights, n) : multiply_scores_scalar(scores, weights, n);
+}
+
+/**
+ * Finds the next score above a threshold, what a top k scan looks for with the score it has to beat
+ * @param scores: scores to scan
+ * @param from: first score to look at
+ * @param n: number of scores
+ * @param threshold: score to beat
+ * @return index of the first score from there that is more than the threshold, n if there is none
+*/
+size_t next_above(const double* scores, size_t from, size_t n, double threshold) {
+    return has_avx2() ? next_above_avx2(scores, from, n, threshold) : next_above_scalar(scores, from, n, threshold);
+}
+
+/**
+ * Finds the next of some docs whose weighted score reaches a threshold, what a score-at-a-time query
+ * looks for among the docs of the segment it just added, with the score of the worst of its leaders
+ * @param accumulators: dense doc ids -> scores so far
+ * @param weights: dense doc ids -> weights, like page ranks, null to weight every score by 1
+ * @param docs: dense doc ids
+ * @param from: first doc to look at
+ * @param n: number of docs
+ * @param threshold: score to reach
+ * @return index of the first doc from there whose score times its weight is at least the threshold, n if there is none
+*/
+size_t next_reaching(const double* accumulators, const double* weights, const int* docs, size_t from, size_t n, double threshold) {
+    return has_avx2() ? next_reaching_avx2(accumulators, weights, docs, from, n, threshold) : next_reaching_scalar(accumulators, weights, docs, from, n, threshold);
+}
+
+// scalar references, what the AVX2 kernels have to match
+
+void add_scores_scalar(double* accumulators, const int* docs, const double* scores, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        accumulators[docs[i]] += scores[i];
+    }
+}
+
+void add_impacts8_scalar(double* accumulators, const int* docs, const uint8_t* impacts, size_t n, double scale) {
+    for (size_t i = 0; i < n; i++) {
+        accumulators[docs[i]] += impacts[i] * scale;
+    }
+}
+
+void add_impacts16_scalar(double* accumulators, const int* docs, const uint16_t* impacts, size_t n, double scale) {
+    for (size_t i = 0; i < n; i++) {
+        accumulators[docs[i]] += impacts[i] * scale;
+    }
+}
+
+void add_constant_scalar(double* accumulators, const int* docs, size_t n, double score) {
+    for (size_t i = 0; i < n; i++) {
+        accumulators[docs[i]] += score;
+    }
+}
+
+void multiply_scores_scalar(double* scores, const double* weights, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        scores[i] *= weights[i];
+    }
+}
+
+size_t next_above_scalar(const double* scores, size_t from, size_t n, double threshold) {
+    for (size_t i = from; i < n; i++) {
+        if (scores[i] > threshold) {
+            return i;
+        }
+    }
+
+    return n;
+}
+
+size_t next_reaching_scalar(const double* accumulators, const double* weights, const int* docs, size_t from, size_t n, double threshold) {
+    for (size_t i = from; i < n; i++) {
+        double score = weights ? accumulators[docs[i]] * weights[docs[i]] : accumulators[docs[i]];
+
+        if (score >= threshold) {
+            return i;
+        }
+    }
+
+    return n;
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/**
+ * Adds 4 values to the accumulators of 4 docs. AVX2 can gather but not scatter, so the sums are stored
+ * one by one, unless the docs are 4 in a row (sorted and distinct, so the last is the first plus 3),
+ * which is most of the postings of a common term: then it's a plain load, add and store
+ * @param accumulators: dense doc ids -> scores so far
+ * @param docs: 4 dense doc ids, distinct and ascending
+ * @param values: what to add to each
+*/
+__attribute__((target("avx2")))
+static inline void add4(double* accumulators, const int* docs, __m256d values) {
+    if (docs[3] - docs[0] == 3) {
+        double* block = accumulators + docs[0];
+        _mm256_storeu_pd(block, _mm256_add_pd(_mm256_loadu_pd(block), values));
+        return;
+    }
+
+    __m128i indices = _mm_loadu_si128((const __m128i*) docs);
+    __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1)); // masked gather of every lane, the plain one trips -Wmaybe-uninitialized
+    __m256d gathered = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), accumulators, indices, all, 8);
+    alignas(32) double sums[4];
+    _mm256_store_pd(sums, _mm256_add_pd(gathered, values));
+    accumulators[docs[0]] = sums[0];
+    accumulators[docs[1]] = sums[1];
+    accumulators[docs[2]] = sums[2];
+    accumulators[docs[3]] = sums[3];
+}
+
+/**
+ * Whether postings are in more than a third of the docs they span, then a gather mostly fetches cache
+ * lines the scalar loop walks through anyway, and costs more than it saves
+ * @param docs: dense doc ids, distinct and ascending
+ * @param n: number of docs
+ * @return true if the scalar loop is faster
+*/
+static bool dense(const int* docs, size_t n) {
+    return n >= 64 && (size_t) (docs[n - 1] - docs[0]) < 3 * n;
+}
+
+__attribute__((target("avx2")))
+void add_scores_avx2(double* accumulators, const int* docs, const double* scores, size_t n) {
+    if (dense(docs, n)) {
+        return add_scores_scalar(accumulators, docs, scores, n);
+    }
+
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        add4(accumulators, docs + i, _mm256_loadu_pd(scores + i));
+    }
+
+    add_scores_scalar(accumulators, docs + i, scores + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void add_impacts8_avx2(double* accumulators, const int* docs, const uint8_t* impacts, size_t n, double scale) {
+    if (dense(docs, n)) {
+        return add_impacts8_scalar(accumulators, docs, impacts, n, scale);
+    }
+
+    __m256d scales = _mm256_set1_pd(scale);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        int packed;
+        __builtin_memcpy(&packed, impacts + i, sizeof(packed));
+        __m128i widened = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed));
+        add4(accumulators, docs + i, _mm256_mul_pd(_mm256_cvtepi32_pd(widened), scales));
+    }
+
+    add_impacts8_scalar(accumulators, docs + i, impacts + i, n - i, scale);
+}
+
+__attribute__((target("avx2")))
+void add_impacts16_avx2(double* accumulators, const int* docs, const uint16_t* impacts, size_t n, double scale) {
+    if (dense(docs, n)) {
+        return add_impacts16_scalar(accumulators, docs, impacts, n, scale);
+    }
+
+    __m256d scales = _mm256_set1_pd(scale);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i widened = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*) (impacts + i)));
+        add4(accumulators, docs + i, _mm256_mul_pd(_mm256_cvtepi32_pd(widened), scales));
+    }
+
+    add_impacts16_scalar(accumulators, docs + i, impacts + i, n - i, scale);
+}
+
+__attribute__((target("avx2")))
+void add_constant_avx2(double* accumulators, const int* docs, size_t n, double score) {
+    if (dense(docs, n)) {
+        return add_constant_scalar(accumulators, docs, n, score);
+    }
+
+    __m256d scores = _mm256_set1_pd(score);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        add4(accumulators, docs + i, scores);
+    }
+
+    add_constant_scalar(accumulators, docs + i, n - i, score);
+}
+
+__attribute__((target("avx2")))
+void multiply_scores_avx2(double* scores, const double* weights, size_t n) {
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(scores + i, _mm256_mul_pd(_mm256_loadu_pd(scores + i), _mm256_loadu_pd(weights + i)));
+    }
+
+    multiply_scores_scalar(scores + i, weights + i, n - i);
+}
+
+/**
+ * Compares 16 scores at a time while none of them beats the threshold, which is nearly always once
+ * the top k has filled up, then finds the first one 4 at a time
+*/
+__attribute__((target("avx2")))
+size_t next_above_avx2(const double* scores, size_t from, size_t n, double threshold) {
+    __m256d bar = _mm256_set1_pd(threshold);
+    size_t i = from;
+
+    for (; i + 16 <= n; i += 16) {
+        __m256d a = _mm256_cmp_pd(_mm256_loadu_pd(scores + i), bar, _CMP_GT_OQ);
+        __m256d b = _mm256_cmp_pd(_mm256_loadu_pd(scores + i + 4), bar, _CMP_GT_OQ);
+        __m256d c = _mm256_cmp_pd(_mm256_loadu_pd(scores + i + 8), bar, _CMP_GT_OQ);
+        __m256d d = _mm256_cmp_pd(_mm256_loadu_pd(scores + i + 12), bar, _CMP_GT_OQ);
+
+        if (_mm256_movemask_pd(_mm256_or_pd(_mm256_or_pd(a, b), _mm256_or_pd(c, d)))) {
+            break;
+        }
+    }
+
+    for (; i + 4 <= n; i += 4) {
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(scores + i), bar, _CMP_GT_OQ));
+
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+
+    return next_above_scalar(scores, i, n, threshold);
+}
+
+__attribute__((target("avx2")))
+size_t next_reaching_avx2(const double* accumulators, const double* weights, const int* docs, size_t from, size_t n, double threshold) {
+    __m256d bar = _mm256_set1_pd(threshold);
+    __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    size_t i = from;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i indices = _mm_loadu_si128((const __m128i*) (docs + i));
+        __m256d scores = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), accumulators, indices, all, 8);
+
+        if (weights) {
+            scores = _mm256_mul_pd(scores, _mm256_mask_i32gather_pd(_mm256_setzero_pd(), weights, indices, all, 8));
+        }
+
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(scores, bar, _CMP_GE_OQ));
+
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+
+    return next_reaching_scalar(accumulators, weights, docs, i, n, threshold);
+}
+
+#else
+
+void add_scores_avx2(double* accumulators, const int* docs, const double* scores, size_t n) {
+    add_scores_scalar(accumulators, docs, scores, n);
+}
+
+void add_impacts8_avx2(double* accumulators, const int* docs, const uint8_t* impacts, size_t n, double scale) {
+    add_impacts8_scalar(accumulators, docs, impacts, n, scale);
+}
+
+void add_impacts16_avx2(double* accumulators, const int* docs, const uint16_t* impacts, size_t n, double scale) {
+    add_impacts16_scalar(accumulators, docs, impacts, n, scale);
+}
+
+void add_constant_avx2(double* accumulators, const int* docs, size_t n, double score) {
+    add_constant_scalar(accumulators, docs, n, score);
+}
+
+void multiply_scores_avx2(double* scores, const double* weights, size_t n) {
+    multiply_scores_scalar(scores, weights, n);
+}
+
+size_t next_above_avx2(const double* scores, size_t from, size_t n, double threshold) {
+    return next_above_scalar(scores, from, n, threshold);
+}
+
+size_t next_reaching_avx2(const double* accumulators, const double* weights, const int* docs, size_t from, size_t n, double threshold) {
+    return next_reaching_scalar(accumulators, weights, docs, from, n, threshold);
+}
+
+#endif
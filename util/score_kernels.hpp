@@ -0,0 +1,43 @@
+#ifndef SCORE_KERNELS_H
+#define SCORE_KERNELS_H
+
+#include <cstdint>
+#include <cstddef>
+
+// inner loops of scoring a query over an array of accumulators indexed by dense doc id: adding a term's
+// postings in, or a segment of postings that all have the same impact, weighting every accumulator by
+// page rank, and finding the accumulators, of every doc or of a segment's, that beat the top k so far. Each comes as a scalar reference and an AVX2 version, compiled for AVX2 on its own so
+// the rest of the program doesn't need it; the unsuffixed ones pick the AVX2 version when the CPU has it.
+// Both versions give the same results to the bit, they do the same double operations per element
+
+bool has_avx2();
+
+void add_scores(double* accumulators, const int* docs, const double* scores, size_t n);
+void add_scores_scalar(double* accumulators, const int* docs, const double* scores, size_t n);
+void add_scores_avx2(double* accumulators, const int* docs, const double* scores, size_t n);
+
+void add_impacts8(double* accumulators, const int* docs, const uint8_t* impacts, size_t n, double scale);
+void add_impacts8_scalar(double* accumulators, const int* docs, const uint8_t* impacts, size_t n, double scale);
+void add_impacts8_avx2(double* accumulators, const int* docs, const uint8_t* impacts, size_t n, double scale);
+
+void add_impacts16(double* accumulators, const int* docs, const uint16_t* impacts, size_t n, double scale);
+void add_impacts16_scalar(double* accumulators, const int* docs, const uint16_t* impacts, size_t n, double scale);
+void add_impacts16_avx2(double* accumulators, const int* docs, const uint16_t* impacts, size_t n, double scale);
+
+void add_constant(double* accumulators, const int* docs, size_t n, double score);
+void add_constant_scalar(double* accumulators, const int* docs, size_t n, double score);
+void add_constant_avx2(double* accumulators, const int* docs, size_t n, double score);
+
+void multiply_scores(double* scores, const double* weights, size_t n);
+void multiply_scores_scalar(double* scores, const double* weights, size_t n);
+void multiply_scores_avx2(double* scores, const double* weights, size_t n);
+
+size_t next_above(const double* scores, size_t from, size_t n, double threshold);
+size_t next_above_scalar(const double* scores, size_t from, size_t n, double threshold);
+size_t next_above_avx2(const double* scores, size_t from, size_t n, double threshold);
+
+size_t next_reaching(const double* accumulators, const double* weights, const int* docs, size_t from, size_t n, double threshold);
+size_t next_reaching_scalar(const double* accumulators, const double* weights, const int* docs, size_t from, size_t n, double threshold);
+size_t next_reaching_avx2(const double* accumulators, const double* weights, const int* docs, size_t from, size_t n, double threshold);
+
+#endif // SCORE_KERNELS_H
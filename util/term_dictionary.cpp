@@ -0,0 +1,186 @@
+#include "term_dictionary.hpp"
+#include "varint.hpp"
+#include <algorithm>
+using std::sort;
+using std::min;
+
+/**
+ * Builds the dictionary, replacing what was there
+ * @param words: term ids -> words, all distinct
+*/
+void TermDictionary::build(const vector<string>& words) {
+    rank_term_ids.resize(words.size());
+
+    for (int i = 0; i < (int) words.size(); i++) {
+        rank_term_ids[i] = i;
+    }
+
+    sort(rank_term_ids.begin(), rank_term_ids.end(), [&](int a, int b) { return words[a] < words[b]; });
+    data.clear();
+    block_offsets.clear();
+    const string* previous = nullptr;
+
+    for (int rank = 0; rank < (int) words.size(); rank++) {
+        const string& word = words[rank_term_ids[rank]];
+        size_t shared = 0;
+
+        if (rank % BLOCK_SIZE == 0) {
+            block_offsets.push_back(data.size()); // whole term, so blocks can be decoded on their own
+        }
+        else {
+            size_t most = min(word.size(), previous->size());
+
+            while (shared < most && word[shared] == (*previous)[shared]) {
+                shared++;
+            }
+        }
+
+        put_varint(data, shared);
+        put_varint(data, word.size() - shared);
+        data.append(word, shared, string::npos);
+        previous = &word;
+    }
+
+    data.shrink_to_fit();
+}
+
+/**
+ * Number of terms in the dictionary
+ * @return terms
+*/
+int TermDictionary::size() const {
+    return rank_term_ids.size();
+}
+
+/**
+ * Memory taken by the dictionary
+ * @return bytes of the terms, block offsets and term ids
+*/
+size_t TermDictionary::memory_bytes() const {
+    return data.capacity() + block_offsets.capacity() * sizeof(uint32_t) + rank_term_ids.capacity() * sizeof(int);
+}
+
+/**
+ * Reads the first term of a block, without copying it
+ * @param block: block number
+ * @return the term
+*/
+string_view TermDictionary::block_head(int block) const {
+    size_t offset = block_offsets[block];
+    get_varint(data.data(), offset); // shares nothing
+    size_t length = get_varint(data.data(), offset);
+
+    return string_view(data.data() + offset, length);
+}
+
+/**
+ * Finds the block a word would be in
+ * @param word: word to look for
+ * @return last block whose first term is at most the word, 0 if the word comes before every term
+*/
+int TermDictionary::find_block(string_view word) const {
+    int low = 0;
+    int high = block_offsets.size(); // answer is in [low, high)
+
+    while (high - low > 1) {
+        int middle = (low + high) / 2;
+
+        if (block_head(middle) <= word) {
+            low = middle;
+        }
+        else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+/**
+ * Looks up the term id of a word
+ * @param word: word to look up
+ * @return term id, -1 if the word isn't a term
+*/
+int TermDictionary::find(string_view word) const {
+    TermIterator it(*this);
+    it.seek(word);
+
+    return !it.done() && it.term() == word ? it.term_id() : -1;
+}
+
+/**
+ * Constructor for TermIterator, starts on the first term
+ * @param terms: dictionary to walk
+*/
+TermIterator::TermIterator(const TermDictionary& terms) : dictionary(&terms) {
+    load_block(0);
+}
+
+/**
+ * Moves to the first term of a block
+ * @param block: block number
+*/
+void TermIterator::load_block(int block) {
+    rank = block * TermDictionary::BLOCK_SIZE;
+    offset = block < (int) dictionary->block_offsets.size() ? dictionary->block_offsets[block] : dictionary->data.size();
+    current.clear();
+
+    if (!done()) {
+        rank--; // next() decodes the block's first term and moves onto it
+        next();
+    }
+}
+
+/**
+ * Whether every term has been walked past
+ * @return true once there are no more terms
+*/
+bool TermIterator::done() const {
+    return rank >= dictionary->size();
+}
+
+/**
+ * Current term
+ * @return the word
+*/
+const string& TermIterator::term() const {
+    return current;
+}
+
+/**
+ * Term id of the current term
+ * @return term id
+*/
+int TermIterator::term_id() const {
+    return dictionary->rank_term_ids[rank];
+}
+
+/**
+ * Moves to the next term in sorted order
+*/
+void TermIterator::next() {
+    rank++;
+
+    if (done()) {
+        return;
+    }
+
+    const char* data = dictionary->data.data();
+    size_t shared = get_varint(data, offset);
+    size_t length = get_varint(data, offset);
+    current.resize(shared);
+    current.append(data + offset, length);
+    offset += length;
+}
+
+/**
+ * Moves to the first term at or after a target, binary searching the blocks then scanning one
+ * @param target: word to move to, before or after the current term
+*/
+void TermIterator::seek(string_view target) {
+    load_block(dictionary->find_block(target));
+
+    while (!done() && string_view(current) < target) {
+        next();
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef TERM_DICTIONARY_H
+#define TERM_DICTIONARY_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+using std::string;
+using std::string_view;
+using std::vector;
+
+// sorted, front-coded term dictionary: the terms are sorted and cut into blocks of BLOCK_SIZE, every
+// block starts with a whole term and every other term is stored as the number of bytes it shares
+// with the term before it plus the rest, so terms can be enumerated in order and ranges found by
+// binary searching the first term of every block
+class TermDictionary {
+    private:
+        static const int BLOCK_SIZE = 16;
+
+        string data; // every term: varint bytes shared with the previous term (0 first in a block), varint length of the rest, the rest
+        vector<uint32_t> block_offsets; // blocks -> offset of their first term in data
+        vector<int> rank_term_ids; // ranks (positions in sorted order) -> term ids
+
+        string_view block_head(int block) const;
+        int find_block(string_view word) const;
+
+        friend class TermIterator;
+
+    public:
+        void build(const vector<string>& words);
+        int size() const;
+        size_t memory_bytes() const;
+        int find(string_view word) const;
+};
+
+// walks the terms of a dictionary in sorted order
+class TermIterator {
+    private:
+        const TermDictionary* dictionary;
+        int rank = 0; // rank of the current term
+        size_t offset = 0; // offset of the next term in the data
+        string current; // the current term, decoded
+
+        void load_block(int block);
+
+    public:
+        TermIterator(const TermDictionary& terms);
+
+        bool done() const;
+        const string& term() const;
+        int term_id() const;
+        void next();
+        void seek(string_view target);
+};
+
+#endif // TERM_DICTIONARY_H
@@ -0,0 +1,93 @@
+#include "thread_pool.hpp"
+#include <mutex>
+using std::unique_lock;
+
+/**
+ * Constructor for ThreadPool, starts the workers
+ * @param threads: number of worker threads, at least 1
+*/
+ThreadPool::ThreadPool(int threads) {
+    for (int i = 0; i < (threads > 1 ? threads : 1); i++) {
+        workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+/**
+ * Destructor for ThreadPool, lets the workers finish and joins them
+*/
+ThreadPool::~ThreadPool() {
+    {
+        unique_lock<ProfiledMutex> lock(mutex);
+        stopping = true;
+    }
+
+    work_ready.notify_all();
+
+    for (thread& worker: workers) {
+        worker.join();
+    }
+}
+
+/**
+ * Number of worker threads
+ * @return size of the pool
+*/
+int ThreadPool::size() const {
+    return workers.size();
+}
+
+/**
+ * Runs run_task(0) .. run_task(tasks - 1) on the workers and waits for all of them, tasks are
+ * claimed in order so the first tasks start first
+ * @param tasks: number of tasks
+ * @param run_task: called once per task with its number, from any worker
+*/
+void ThreadPool::run(int tasks, const function<void(int)>& run_task) {
+    if (tasks <= 0) {
+        return;
+    }
+
+    unique_lock<ProfiledMutex> lock(mutex);
+    task = &run_task;
+    num_tasks = tasks;
+    next_task = 0;
+    unfinished = tasks;
+    work_ready.notify_all();
+
+    work_done.wait(lock, [this]() { return unfinished == 0; });
+    task = nullptr;
+    num_tasks = 0;
+}
+
+/**
+ * Worker loop: claims tasks of the current run until the pool stops
+*/
+void ThreadPool::work() {
+    unique_lock<ProfiledMutex> lock(mutex);
+
+    while (true) {
+        work_ready.wait(lock, [this]() { return stopping || next_task < num_tasks; });
+
+        if (next_task >= num_tasks) {
+            return; // stopping, and nothing left to do
+        }
+
+        int task_num = next_task++;
+        const function<void(int)>& curr_task = *task;
+        lock.unlock();
+        curr_task(task_num);
+        lock.lock();
+
+        if (--unfinished == 0) {
+            work_done.notify_one();
+        }
+    }
+}
+
+/**
+ * Takes the contention stats of the pool's mutex gathered so far and starts over
+ * @return stats since the last call (all 0 without LOCK_PROFILING)
+*/
+LockStats ThreadPool::take_lock_stats() {
+    return mutex.take_stats();
+}
@@ -0,0 +1,40 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include "util/profiled_mutex.hpp"
+using std::vector;
+using std::thread;
+using std::function;
+using std::condition_variable_any;
+
+// fixed set of worker threads, started once and reused by every parallel phase
+class ThreadPool {
+    private:
+        vector<thread> workers;
+        ProfiledMutex mutex; // guards everything below
+        condition_variable_any work_ready; // signalled when tasks are posted or the pool stops
+        condition_variable_any work_done; // signalled when the last task of a run finishes
+        const function<void(int)>* task = nullptr; // task of the current run
+        int num_tasks = 0; // tasks in the current run
+        int next_task = 0; // first task nobody has claimed yet
+        int unfinished = 0; // tasks of the current run that haven't finished
+        bool stopping = false;
+
+        void work();
+
+    public:
+        ThreadPool(int threads);
+        ~ThreadPool();
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        int size() const;
+        void run(int tasks, const function<void(int)>& run_task);
+        LockStats take_lock_stats();
+};
+
+#endif // THREAD_POOL_H
@@ -9,7 +9,7 @@ auto end = std::chrono::system_clock::now(); // end time
  * @param delimiter: delimiter to split string with
  * @return vector of strings split on delimiter
 */
-vector<string> split_string(string str, char delimiter) {   
+vector<string> split_string(string_view str, char delimiter) {   
     vector<string> ans;
     string curr_word = "";
 
@@ -33,23 +33,30 @@ vector<string> split_string(string str, char delimiter) {
  * @param str: string to convert
  * @return string as lowercase
 */
-string lower(const string& str) {
-    string result = str;
+string lower(string_view str) {
+    string result(str);
+    lower_in_place(result);
 
-    for (char& c : result) {
+    return result;
+}
+
+/**
+ * Converts string to lowercase without copying it
+ * @param str: string to convert
+*/
+void lower_in_place(string& str) {
+    for (char& c : str) {
         c = tolower(c);
     }
-
-    return result;
 }
 
 /**
  * Strips leading and trailing whitespace for strings
  * @param str: string to strip
- * @return string with appropriate whitespace removed
+ * @return view of str with appropriate whitespace removed
 */
-string trim(const string& str) {
-    const string whitespace = " \t\n";
+string_view trim(string_view str) {
+    const string_view whitespace = " \t\n";
     const auto str_start = str.find_first_not_of(whitespace);
 
     if (str_start == string::npos) {
@@ -68,11 +75,20 @@ void start_timer() {
     start = std::chrono::system_clock::now();
 }
 
+/**
+ * Read the timer without displaying it
+ * @return seconds elapsed since start_timer
+*/
+double elapsed_seconds() {
+    end = std::chrono::system_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+
+    return elapsed.count();
+}
+
 /**
  * End the timer and display elapsed time
 */
 void stop_timer() {
-    end = std::chrono::system_clock::now();
-    std::chrono::duration<double> elapsed_seconds = end - start;
-    cout << "elapsed time: " << elapsed_seconds.count() << "s\n";
+    cout << "elapsed time: " << elapsed_seconds() << "s\n";
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define UTIL_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <chrono>
 #include <ctime>
@@ -10,16 +11,19 @@
 using std::cout;
 using std::vector;
 using std::string;
+using std::string_view;
 using std::tolower;
 using std::time_t;
 using std::localtime;
 using std::tm;
 using std::ctime;
 
-vector<string> split_string(string str, char delimiter);
-string lower(const string& str);
-string trim(const string& str);
+vector<string> split_string(string_view str, char delimiter);
+string lower(string_view str);
+void lower_in_place(string& str);
+string_view trim(string_view str);
 void start_timer();
+double elapsed_seconds();
 void stop_timer();
 
 #endif // UTIL_H
\ No newline at end of file
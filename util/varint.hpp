@@ -0,0 +1,76 @@
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <string>
+#include <cstdint>
+using std::string;
+
+// LEB128 variable length integers: 7 bits per byte, high bit set on every byte but the last,
+// so small numbers (like the gaps between sorted positions) take a single byte
+
+/**
+ * Appends a varint to a buffer
+ * @param buffer: buffer to append to
+ * @param value: number to encode
+*/
+inline void put_varint(string& buffer, uint32_t value) {
+    while (value >= 0x80) {
+        buffer += (char) (value | 0x80);
+        value >>= 7;
+    }
+
+    buffer += (char) value;
+}
+
+/**
+ * Writes a varint into a buffer with room for it
+ * @param data: buffer to write to
+ * @param offset: where the varint starts, moved past it
+ * @param value: number to encode
+*/
+inline void put_varint(char* data, size_t& offset, uint32_t value) {
+    while (value >= 0x80) {
+        data[offset++] = (char) (value | 0x80);
+        value >>= 7;
+    }
+
+    data[offset++] = (char) value;
+}
+
+/**
+ * Number of bytes a varint takes
+ * @param value: number to encode
+ * @return bytes, 1 to 5
+*/
+inline size_t varint_length(uint32_t value) {
+    size_t length = 1;
+
+    while (value >= 0x80) {
+        value >>= 7;
+        length++;
+    }
+
+    return length;
+}
+
+/**
+ * Reads a varint from a buffer
+ * @param data: buffer to read from
+ * @param offset: where the varint starts, moved past it
+ * @return decoded number
+*/
+inline uint32_t get_varint(const char* data, size_t& offset) {
+    uint32_t value = 0;
+    int shift = 0;
+    unsigned char byte;
+
+    do {
+        byte = data[offset++];
+        value |= (uint32_t) (byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    return value;
+}
+
+#endif // VARINT_H